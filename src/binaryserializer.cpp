@@ -0,0 +1,410 @@
+/*
+  This file is part of Flow.
+
+  Copyright (C) 2015 Sérgio Martins <iamsergio@gmail.com>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "binaryserializer.h"
+#include "kernel.h"
+#include "taskrecord.h"
+
+#include <QHash>
+#include <QUuid>
+#include <QVector>
+#include <QtEndian>
+
+static const char s_magic[] = "FLOWBIN";
+static const int s_magicSize = sizeof(s_magic) - 1;
+
+enum RecordFlag {
+    StringUuidFlag = 1, // uuid isn't in canonical form, so it's stored as a string
+    StagedFlag = 2,
+    ModificationFlag = 4,
+    LastPomodoroFlag = 8,
+    DueDateFlag = 16
+};
+
+namespace {
+
+class Writer
+{
+public:
+    explicit Writer(QByteArray &data)
+        : m_data(data)
+    {
+    }
+
+    void writeByte(quint8 byte)
+    {
+        m_data.append(char(byte));
+    }
+
+    void writeVarUInt(quint64 value)
+    {
+        while (value >= 0x80) {
+            writeByte(quint8(value) | 0x80);
+            value >>= 7;
+        }
+        writeByte(quint8(value));
+    }
+
+    void writeVarInt(qint64 value) // zigzag, so -1 takes a single byte
+    {
+        writeVarUInt((quint64(value) << 1) ^ quint64(value >> 63));
+    }
+
+    void writeInt64(qint64 value)
+    {
+        uchar buffer[8];
+        qToLittleEndian<qint64>(value, buffer);
+        m_data.append(reinterpret_cast<const char*>(buffer), 8);
+    }
+
+    void writeBytes(const QByteArray &bytes)
+    {
+        writeVarUInt(bytes.size());
+        m_data.append(bytes);
+    }
+
+    void writeString(const QString &str)
+    {
+        writeBytes(str.toUtf8());
+    }
+
+    // Returns the flag to set if the uuid had to be written as a string
+    quint8 uuidFlag(const QString &uuid) const
+    {
+        const QUuid quuid(uuid);
+        return (!quuid.isNull() && quuid.toString() == uuid) ? 0 : StringUuidFlag;
+    }
+
+    void writeUuid(const QString &uuid, quint8 flags)
+    {
+        if (flags & StringUuidFlag)
+            writeString(uuid);
+        else
+            m_data.append(QUuid(uuid).toRfc4122());
+    }
+
+private:
+    QByteArray &m_data;
+};
+
+class Reader
+{
+public:
+    explicit Reader(const QByteArray &data)
+        : m_pos(data.constData())
+        , m_end(data.constData() + data.size())
+        , m_error(false)
+    {
+    }
+
+    bool hasError() const
+    {
+        return m_error;
+    }
+
+    bool skip(int count)
+    {
+        if (m_error || m_end - m_pos < count) {
+            m_error = true;
+            return false;
+        }
+        m_pos += count;
+        return true;
+    }
+
+    quint8 readByte()
+    {
+        const char *pos = m_pos;
+        return skip(1) ? quint8(*pos) : 0;
+    }
+
+    quint64 readVarUInt()
+    {
+        quint64 value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            const quint8 byte = readByte();
+            value |= quint64(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return value;
+        }
+        m_error = true;
+        return 0;
+    }
+
+    qint64 readVarInt()
+    {
+        const quint64 value = readVarUInt();
+        return qint64(value >> 1) ^ -qint64(value & 1);
+    }
+
+    qint64 readInt64()
+    {
+        const char *pos = m_pos;
+        return skip(8) ? qFromLittleEndian<qint64>(reinterpret_cast<const uchar*>(pos)) : 0;
+    }
+
+    QByteArray readBytes()
+    {
+        const quint64 size = readVarUInt();
+        const char *pos = m_pos;
+        if (size > quint64(m_end - m_pos) || !skip(int(size))) {
+            m_error = true;
+            return QByteArray();
+        }
+        return QByteArray(pos, int(size));
+    }
+
+    QString readString()
+    {
+        const quint64 size = readVarUInt();
+        const char *pos = m_pos;
+        if (size > quint64(m_end - m_pos) || !skip(int(size))) {
+            m_error = true;
+            return QString();
+        }
+        return QString::fromUtf8(pos, int(size));
+    }
+
+    QString readUuid(quint8 flags)
+    {
+        if (flags & StringUuidFlag)
+            return readString();
+
+        const char *pos = m_pos;
+        return skip(16) ? QUuid::fromRfc4122(QByteArray::fromRawData(pos, 16)).toString() : QString();
+    }
+
+    // Counts are validated against the remaining size, so corrupted data can't make us allocate a lot
+    int readCount()
+    {
+        const quint64 count = readVarUInt();
+        if (count > quint64(m_end - m_pos)) {
+            m_error = true;
+            return 0;
+        }
+        return int(count);
+    }
+
+private:
+    const char *m_pos;
+    const char *const m_end;
+    bool m_error;
+};
+
+}
+
+bool BinarySerializer::isBinaryData(const QByteArray &data)
+{
+    return data.startsWith(s_magic);
+}
+
+QByteArray BinarySerializer::serialize(const QVariantMap &root)
+{
+    const QVariantList tagsVariant = root.value("tags").toList();
+    const QVariantList tasksVariant = root.value("tasks").toList();
+
+    QByteArray data;
+    data.reserve(64 + tasksVariant.count() * 128);
+    Writer writer(data);
+    data.append(s_magic, s_magicSize);
+    writer.writeVarUInt(BinarySerializerVersion1);
+    writer.writeBytes(root.value("instanceId").toByteArray());
+
+    QHash<QString, int> tagIndexes;
+    writer.writeVarUInt(tagsVariant.count());
+    foreach (const QVariant &tagVariant, tagsVariant) {
+        const TagRecord tag = Tag::recordFromJson(tagVariant.toMap());
+        const quint8 flags = writer.uuidFlag(tag.uuid);
+        writer.writeByte(flags);
+        writer.writeUuid(tag.uuid, flags);
+        writer.writeVarInt(tag.revision);
+        writer.writeVarInt(tag.revisionOnWebDAVServer);
+        writer.writeString(tag.name);
+        if (!tagIndexes.contains(tag.name))
+            tagIndexes.insert(tag.name, tagIndexes.count());
+    }
+
+    QVector<TaskRecord> tasks;
+    tasks.reserve(tasksVariant.count());
+    QStringList extraTagNames; // Referenced by tasks but not in the tag table, shouldn't happen
+    foreach (const QVariant &taskVariant, tasksVariant) {
+        tasks << Task::recordFromJson(taskVariant.toMap());
+        foreach (const QString &tagName, tasks.last().tags) {
+            if (!tagIndexes.contains(tagName)) {
+                tagIndexes.insert(tagName, tagIndexes.count());
+                extraTagNames << tagName;
+            }
+        }
+    }
+
+    writer.writeVarUInt(extraTagNames.count());
+    foreach (const QString &tagName, extraTagNames)
+        writer.writeString(tagName);
+
+    writer.writeVarUInt(tasks.count());
+    foreach (const TaskRecord &task, tasks) {
+        quint8 flags = writer.uuidFlag(task.uuid);
+        if (task.staged)
+            flags |= StagedFlag;
+        if (task.modificationTimestamp != TaskRecord::NoTimestamp)
+            flags |= ModificationFlag;
+        if (task.lastPomodoroTimestamp != TaskRecord::NoTimestamp)
+            flags |= LastPomodoroFlag;
+        if (task.hasDueDate)
+            flags |= DueDateFlag;
+
+        writer.writeByte(flags);
+        writer.writeUuid(task.uuid, flags);
+        writer.writeVarInt(task.revision);
+        writer.writeVarInt(task.revisionOnWebDAVServer);
+        writer.writeString(task.summary);
+        writer.writeString(task.description);
+        writer.writeVarInt(task.priority);
+        writer.writeInt64(task.creationTimestamp);
+        if (flags & ModificationFlag)
+            writer.writeInt64(task.modificationTimestamp);
+        if (flags & LastPomodoroFlag)
+            writer.writeInt64(task.lastPomodoroTimestamp);
+        if (flags & DueDateFlag)
+            writer.writeVarInt(task.dueDate);
+
+        writer.writeVarUInt(task.tags.count());
+        foreach (const QString &tagName, task.tags)
+            writer.writeVarUInt(tagIndexes.value(tagName));
+    }
+
+    return data;
+}
+
+Storage::Data BinarySerializer::deserialize(const QByteArray &serializedData, QString &errorMsg,
+                                            Kernel *kernel)
+{
+    Storage::Data result;
+    QVector<TagRecord> tagRecords;
+    QVector<TaskRecord> taskRecords;
+    if (!deserializeRecords(serializedData, errorMsg, result.instanceId, tagRecords, taskRecords))
+        return Storage::Data();
+
+    foreach (const TagRecord &record, tagRecords) {
+        Tag::Ptr tag = Tag::Ptr(new Tag(kernel, QString()));
+        tag->fromRecord(record);
+        if (!tag->name().isEmpty() && !Storage::itemListContains<Tag::Ptr>(result.tags, tag)) {
+            if (kernel) // Reuse tags from given storage
+                tag = kernel->storage()->tag(tag->name());
+            result.tags << tag;
+        }
+    }
+
+    QList<Task::Ptr> tasks;
+    tasks.reserve(taskRecords.count());
+    foreach (const TaskRecord &record, taskRecords) {
+        Task::Ptr task = Task::createTask(kernel);
+        task->fromRecord(record);
+        tasks << task;
+    }
+    result.tasks << tasks;
+
+    if (result.instanceId.isEmpty())
+        result.instanceId = QUuid::createUuid().toByteArray();
+
+    return result;
+}
+
+bool BinarySerializer::deserializeRecords(const QByteArray &serializedData, QString &errorMsg,
+                                          QByteArray &instanceId, QVector<TagRecord> &tags,
+                                          QVector<TaskRecord> &tasks)
+{
+    errorMsg.clear();
+    if (!isBinaryData(serializedData)) {
+        errorMsg = QStringLiteral("Not a binary data file");
+        return false;
+    }
+
+    Reader reader(serializedData);
+    reader.skip(s_magicSize);
+    const quint64 version = reader.readVarUInt();
+    if (version > BinarySerializerVersion1) {
+        errorMsg = QString("Found binary serializer version %1 which is bigger than %2. Update your application").arg(version).arg(int(BinarySerializerVersion1));
+        return false;
+    }
+
+    instanceId = reader.readBytes();
+
+    QStringList tagNames;
+    const int tagCount = reader.readCount();
+    for (int i = 0; i < tagCount && !reader.hasError(); ++i) {
+        TagRecord record;
+        const quint8 flags = reader.readByte();
+        record.uuid = reader.readUuid(flags);
+        record.revision = reader.readVarInt();
+        record.revisionOnWebDAVServer = reader.readVarInt();
+        record.name = reader.readString();
+        if (reader.hasError())
+            break;
+
+        if (!tagNames.contains(record.name))
+            tagNames << record.name;
+
+        tags << record;
+    }
+
+    const int extraTagNameCount = reader.readCount();
+    for (int i = 0; i < extraTagNameCount && !reader.hasError(); ++i)
+        tagNames << reader.readString();
+
+    const int taskCount = reader.readCount();
+    tasks.reserve(tasks.count() + taskCount);
+    for (int i = 0; i < taskCount && !reader.hasError(); ++i) {
+        TaskRecord record;
+        const quint8 flags = reader.readByte();
+        record.uuid = reader.readUuid(flags);
+        record.revision = reader.readVarInt();
+        record.revisionOnWebDAVServer = reader.readVarInt();
+        record.summary = reader.readString();
+        record.description = reader.readString();
+        record.staged = flags & StagedFlag;
+        record.priority = reader.readVarInt();
+        record.creationTimestamp = reader.readInt64();
+        record.modificationTimestamp = (flags & ModificationFlag) ? reader.readInt64() : TaskRecord::NoTimestamp;
+        record.lastPomodoroTimestamp = (flags & LastPomodoroFlag) ? reader.readInt64() : TaskRecord::NoTimestamp;
+        if (flags & DueDateFlag) {
+            record.hasDueDate = true;
+            record.dueDate = reader.readVarInt();
+        }
+
+        const int taskTagCount = reader.readCount();
+        for (int j = 0; j < taskTagCount; ++j) {
+            const quint64 index = reader.readVarUInt();
+            if (index < quint64(tagNames.count()))
+                record.tags << tagNames.at(int(index));
+        }
+
+        if (reader.hasError())
+            break;
+
+        tasks << record;
+    }
+
+    if (reader.hasError()) {
+        errorMsg = QStringLiteral("Binary data file is truncated or corrupted");
+        return false;
+    }
+
+    return true;
+}
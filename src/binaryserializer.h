@@ -0,0 +1,53 @@
+/*
+  This file is part of Flow.
+
+  Copyright (C) 2015 Sérgio Martins <iamsergio@gmail.com>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FLOW_BINARYSERIALIZER_H
+#define FLOW_BINARYSERIALIZER_H
+
+#include "storage.h"
+
+#include <QByteArray>
+#include <QVariantMap>
+#include <QVector>
+
+class Kernel;
+
+enum {
+    BinarySerializerVersion1 = 1
+};
+
+// Compact alternative to the json data file. Length-prefixed layout with varints, uuids as
+// 16 raw bytes, timestamps as int64 and task tags as indices into the tag table.
+// Json stays the format for import, export and WebDAV sync.
+class BinarySerializer
+{
+public:
+    static bool isBinaryData(const QByteArray &);
+
+    // root has the same layout JsonStorage uses for the json file. Thread-safe.
+    static QByteArray serialize(const QVariantMap &root);
+    static Storage::Data deserialize(const QByteArray &serializedData, QString &errorMsg,
+                                     Kernel *kernel);
+    // Same, but without creating any Tag or Task. Thread-safe.
+    static bool deserializeRecords(const QByteArray &serializedData, QString &errorMsg,
+                                   QByteArray &instanceId, QVector<TagRecord> &tags,
+                                   QVector<TaskRecord> &tasks);
+};
+
+#endif
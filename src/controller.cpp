@@ -490,8 +490,15 @@ void Controller::setQueueType(QueueType type)
     if (type != m_queueType) {
         m_queueType = type;
 
-        if (type == QueueTypeArchive)
+        if (type == QueueTypeArchive) {
+            m_storage->loadArchive();
+            materializeArchivedTasks(m_currentTag.data());
             m_loadManager->setArchiveRequested(true);
+        } else {
+            // Whatever the archive view created and didn't touch goes back to being a record
+            m_storage->recycleMaterializedTasks(QList<Task*>() << m_currentTask.data() << m_taskBeingEdited.data()
+                                                               << m_rightClickedTask.data() << m_selectedTask.data());
+        }
 
         emit queueTypeChanged();
         emit currentTitleTextChanged();
@@ -688,14 +695,31 @@ void Controller::setCurrentTag(Tag *tag)
         }
 
         m_currentTag = tag;
+        if (m_queueType == QueueTypeArchive)
+            materializeArchivedTasks(tag);
         emit currentTagChanged();
     }
 }
 
+void Controller::materializeArchivedTasks(Tag *tag)
+{
+    // Dormant tasks only have Task objects once their tab is shown
+    if (!tag || tag == m_dueDateTasksTag.data())
+        return; // Tasks with due date are never dormant
+
+    if (tag == m_allTasksTag.data())
+        m_storage->materializeAllTasks();
+    else if (tag == m_untaggedTasksTag.data())
+        m_storage->materializeTasksWithTag(QString());
+    else
+        m_storage->materializeTasksWithTag(tag->name());
+}
+
 void Controller::setRightClickedTask(Task *task, bool tagOnlyMenu)
 {
     //if (m_rightClickedTask != task) { // m_rightClickedTask is a QPointer and task might have been deleted
         setCurrentMenuIndex(-1);
+        QPointer<Task> previousTask = m_rightClickedTask;
         m_rightClickedTask = task;
         if (task) {
             task->contextMenuModel()->setTagOnlyMenu(tagOnlyMenu);
@@ -703,6 +727,9 @@ void Controller::setRightClickedTask(Task *task, bool tagOnlyMenu)
         }
 
         emit rightClickedTaskChanged();
+
+        if (previousTask && previousTask != task) // Its menu closed
+            previousTask->releaseMenuModels();
     //}
 }
 
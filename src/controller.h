@@ -336,6 +336,7 @@ private:
     QAbstractItemModel *currentTabTaskModel() const;
     void setTaskStatus(TaskStatus status);
     void setTagEditStatus(TagEditStatus);
+    void materializeArchivedTasks(Tag *tag);
     bool eventFilter(QObject *, QEvent *) Q_DECL_OVERRIDE;
 
     Kernel *m_kernel;
@@ -2,6 +2,7 @@
 #define REALLY_GENERIC_LIST_MODEL_H
 
 #include <QList>
+#include <QVector>
 #include <QDebug>
 #include <QGuiApplication>
 #include <QAbstractListModel>
@@ -35,12 +36,16 @@ class GenericListModel : public QList<T>
 public:
     GenericListModel();
     GenericListModel(const GenericListModel &other);
+    GenericListModel(const QList<T> &other);
 #ifdef Q_COMPILER_INITIALIZER_LISTS
     GenericListModel(std::initializer_list<T> args);
 #endif
     ~GenericListModel();
 
     operator QAbstractListModel*() const { return m_model; }
+    // For read-only access return a const QList<T>& instead of a copy, a copy creates a new model.
+    // The list behind a model obtained through the operator above, or null if it's another model
+    static const GenericListModel<T> *fromModel(const QAbstractItemModel *);
     void insertRole(const QByteArray &name, GetterFunc getter, int role = -1);
     void setDataFunction(QVariant (*)(const GenericListModel<T> &list, int role, int index));
 
@@ -99,7 +104,21 @@ class _InternalModelBase : public QAbstractListModel
     Q_PROPERTY(int count READ count NOTIFY countChanged)
     Q_OBJECT
 public:
-    explicit _InternalModelBase(QObject *parent = 0) : QAbstractListModel(parent) {}
+    explicit _InternalModelBase(QObject *parent = 0) : QAbstractListModel(parent)
+    {
+#if defined(QT_TESTLIB_LIB)
+        allocationCount()++;
+#endif
+    }
+
+#if defined(QT_TESTLIB_LIB)
+    // How many models were ever created, so tests can check read access doesn't create any
+    static int &allocationCount()
+    {
+        static int count = 0;
+        return count;
+    }
+#endif
 
     int count() const
     {
@@ -144,24 +163,27 @@ public:
         if (!index.isValid())
             return QVariant();
 
-        QHash<int, QByteArray>::const_iterator it;
-        for (it = m_roles.cbegin(); it != m_roles.cend(); ++it) {
-            if (it.key() == role) {
-                GetterFunc func = m_getters.value(it.key());
-                return func ? func(index.row())
+        // Called for every role of every visible row, so it's a flat table lookup
+        const int slot = role - Qt::UserRole;
+        if (slot < 0 || slot >= m_roleTable.count() || !m_roleTable.at(slot).registered)
+            return QVariant();
+
+        const RoleEntry &entry = m_roleTable.at(slot);
+        return entry.getter ? entry.getter(index.row())
                             : m_dataFunction ? m_dataFunction(m_list, index.row(), role)
                                              : QVariant();
-
-            }
-        }
-
-        return QVariant();
     }
 
     void insertRole(const QByteArray &name, GetterFunc getter, int role)
     {
+        Q_ASSERT(role >= Qt::UserRole);
         m_roles.insert(role, name);
-        m_getters.insert(role, getter);
+
+        const int slot = role - Qt::UserRole;
+        if (slot >= m_roleTable.count())
+            m_roleTable.resize(slot + 1);
+        m_roleTable[slot].registered = true;
+        m_roleTable[slot].getter = getter;
     }
 
     void setDataFunction(QVariant (*function)(const GenericListModel<T> &, int index, int role))
@@ -170,8 +192,14 @@ public:
     }
 
 private:
+    struct RoleEntry {
+        RoleEntry() : registered(false), getter(Q_NULLPTR) {}
+        bool registered;
+        GetterFunc getter;
+    };
+
     QHash<int, QByteArray> m_roles;
-    QHash<int, GetterFunc> m_getters;
+    QVector<RoleEntry> m_roleTable; // indexed by role - Qt::UserRole
     GenericListModel<T> &m_list;
     QVariant (*m_dataFunction)(const GenericListModel<T> &, int index, int role);
 
@@ -191,6 +219,12 @@ GenericListModel<T>::GenericListModel(const GenericListModel &other)
     , m_model(new _InternalModel<T>(*this))
 {}
 
+template <typename T>
+GenericListModel<T>::GenericListModel(const QList<T> &other)
+    : QList<T>(other)
+    , m_model(new _InternalModel<T>(*this))
+{}
+
 #ifdef Q_COMPILER_INITIALIZER_LISTS
 template <typename T>
 GenericListModel<T>::GenericListModel(std::initializer_list<T> args)
@@ -199,6 +233,13 @@ GenericListModel<T>::GenericListModel(std::initializer_list<T> args)
 {}
 #endif
 
+template <typename T>
+const GenericListModel<T> *GenericListModel<T>::fromModel(const QAbstractItemModel *model)
+{
+    const _InternalModel<T> *internalModel = dynamic_cast<const _InternalModel<T>*>(model);
+    return internalModel ? &internalModel->m_list : Q_NULLPTR;
+}
+
 template <typename T>
 GenericListModel<T>::~GenericListModel()
 {
@@ -217,8 +258,12 @@ void GenericListModel<T>::append(const T &t)
 template <typename T>
 void GenericListModel<T>::append(const QList<T> &list)
 {
+    if (list.isEmpty())
+        return;
+
+    // A single insertion for the whole range
     int count = this->count();
-    m_model->beginInsertRows(QModelIndex(), count, count + list.count());
+    m_model->beginInsertRows(QModelIndex(), count, count + list.count() - 1);
     QList<T>::append(list);
     m_model->endInsertRows();
 }
@@ -18,27 +18,355 @@
 */
 
 #include "jsonstorage.h"
+#include "storagewriter.h"
+#include "binaryserializer.h"
+#include "jsonstreamreader.h"
 #include "kernel.h"
 
 #include <QDir>
 #include <QFile>
+#include <QFileInfo>
+#include <QDataStream>
 #include <QJsonDocument>
 #include <QTemporaryFile>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QAtomicInt>
+
+enum {
+    CompactionDelay = 5000, // Fold the journal into the snapshot only after some quiet time
+    MinimumJournalSizeForCompaction = 256 * 1024,
+    ArchiveMagic = 0x464c4141, // "FLAA"
+    MinimumTasksPerParserThread = 1024, // Below this, starting threads costs more than it saves
+    WriteRetryDelay = 2000, // Doubled on each consecutive failure
+    MaximumWriteRetries = 5 // After that only new changes trigger a save
+};
+
+static QByteArray journalRecord(const QVariantMap &record)
+{
+    // One compact json document per line
+    return QJsonDocument::fromVariant(record).toJson(QJsonDocument::Compact) + '\n';
+}
 
 JsonStorage::JsonStorage(Kernel *kernel, QObject *parent)
     : Storage(kernel, parent)
     , m_runtimeConfiguration(kernel->runtimeConfiguration())
+    , m_snapshotSize(0)
+    , m_journalSize(0)
+    , m_writer(Q_NULLPTR)
+    , m_pendingWrites(0)
+    , m_lastSaveBytesWritten(0)
+    , m_totalBytesWritten(0)
+    , m_archiveLoaded(true)
+    , m_archiveFileExists(false)
+    , m_failedWrites(0)
 {
+    m_compactionTimer.setSingleShot(true);
+    m_compactionTimer.setInterval(CompactionDelay);
+    connect(&m_compactionTimer, &QTimer::timeout, this, &JsonStorage::compactJournal);
+    m_retryTimer.setSingleShot(true);
+    connect(&m_retryTimer, &QTimer::timeout, this, &JsonStorage::scheduleSave);
 }
 
 JsonStorage::~JsonStorage()
 {
     if (saveScheduled() && m_runtimeConfiguration.saveEnabled())
         save_impl();
+
+    if (m_writer) {
+        // Requests are processed in order, so this returns once everything queued was written
+        QMetaObject::invokeMethod(m_writer, "flush", Qt::BlockingQueuedConnection);
+        m_writerThread.quit();
+        m_writerThread.wait();
+        delete m_writer;
+    }
+}
+
+// Returns the type of the value that follows a name, nested containers of unexpected values are skipped
+static JsonStreamReader::TokenType readScalar(JsonStreamReader &reader)
+{
+    const JsonStreamReader::TokenType type = reader.readNext();
+    if (type == JsonStreamReader::BeginObject || type == JsonStreamReader::BeginArray)
+        reader.skipContainer();
+    return type;
+}
+
+// Reads the next token and returns true if it opens an array, other values are skipped
+static bool enterArray(JsonStreamReader &reader)
+{
+    switch (reader.readNext()) {
+    case JsonStreamReader::BeginArray:
+        return true;
+    case JsonStreamReader::BeginObject:
+        reader.skipContainer();
+        return false;
+    default:
+        return false;
+    }
+}
+
+// Reads the array elements until the closing bracket. Returns false when there are no more objects.
+static bool nextObjectInArray(JsonStreamReader &reader)
+{
+    forever {
+        switch (reader.readNext()) {
+        case JsonStreamReader::BeginObject:
+            return true;
+        case JsonStreamReader::BeginArray:
+            reader.skipContainer();
+            break;
+        case JsonStreamReader::EndArray:
+        case JsonStreamReader::EndDocument:
+        case JsonStreamReader::Invalid:
+            return false;
+        default: // scalars aren't tasks nor tags
+            break;
+        }
+    }
+}
+
+static void readTagRecord(JsonStreamReader &reader, TagRecord &record)
+{
+    while (reader.readNext() == JsonStreamReader::Name) {
+        if (reader.isName("name")) {
+            readScalar(reader);
+            record.name = reader.stringValue();
+        } else if (reader.isName("uuid")) {
+            readScalar(reader);
+            record.uuid = reader.stringValue();
+        } else if (reader.isName("revision")) {
+            readScalar(reader);
+            record.revision = reader.integerValue();
+        } else if (reader.isName("revisionOnWebDAVServer")) {
+            readScalar(reader);
+            record.revisionOnWebDAVServer = reader.integerValue();
+        } else {
+            reader.skipValue();
+        }
+    }
+}
+
+static void readTaskRecord(JsonStreamReader &reader, TaskRecord &record)
+{
+    while (reader.readNext() == JsonStreamReader::Name) {
+        if (reader.isName("summary")) {
+            readScalar(reader);
+            record.summary = reader.stringValue();
+        } else if (reader.isName("description")) {
+            readScalar(reader);
+            record.description = reader.stringValue();
+        } else if (reader.isName("uuid")) {
+            readScalar(reader);
+            record.uuid = reader.stringValue();
+        } else if (reader.isName("revision")) {
+            readScalar(reader);
+            record.revision = reader.integerValue();
+        } else if (reader.isName("revisionOnWebDAVServer")) {
+            readScalar(reader);
+            record.revisionOnWebDAVServer = reader.integerValue();
+        } else if (reader.isName("staged")) {
+            readScalar(reader);
+            record.staged = reader.boolValue();
+        } else if (reader.isName("priority")) {
+            readScalar(reader);
+            record.priority = reader.integerValue();
+        } else if (reader.isName("creationTimestamp")) {
+            readScalar(reader);
+            record.creationTimestamp = reader.integerValue();
+        } else if (reader.isName("modificationTimestamp")) {
+            readScalar(reader);
+            record.modificationTimestamp = reader.integerValue();
+        } else if (reader.isName("lastPomodoroDate")) {
+            readScalar(reader);
+            record.lastPomodoroTimestamp = reader.integerValue();
+        } else if (reader.isName("dueDate")) {
+            readScalar(reader);
+            record.hasDueDate = true;
+            record.dueDate = reader.integerValue();
+        } else if (reader.isName("tags")) {
+            if (enterArray(reader)) {
+                forever {
+                    const JsonStreamReader::TokenType type = readScalar(reader);
+                    if (type == JsonStreamReader::EndArray || type == JsonStreamReader::EndDocument
+                            || type == JsonStreamReader::Invalid)
+                        break;
+                    record.tags << reader.stringValue();
+                }
+            }
+        } else {
+            reader.skipValue();
+        }
+    }
+}
+
+namespace {
+
+struct JsonSpan {
+    int begin;
+    int end;
+};
+
+// Parses task objects into records, in a worker thread. Each parser owns its slice of records.
+class TaskRecordParser : public QRunnable
+{
+public:
+    TaskRecordParser(const QByteArray &data, const QVector<JsonSpan> &spans, int first, int last,
+                     TaskRecord *records, QAtomicInt &errorCount)
+        : m_data(data)
+        , m_spans(spans)
+        , m_first(first)
+        , m_last(last)
+        , m_records(records)
+        , m_errorCount(errorCount)
+    {
+    }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        for (int i = m_first; i < m_last; ++i) {
+            const JsonSpan &span = m_spans.at(i);
+            const QByteArray object = QByteArray::fromRawData(m_data.constData() + span.begin,
+                                                              span.end - span.begin);
+            JsonStreamReader reader(object);
+            if (reader.readNext() == JsonStreamReader::BeginObject)
+                readTaskRecord(reader, m_records[i]);
+            if (reader.hasError())
+                m_errorCount.ref();
+        }
+    }
+
+private:
+    const QByteArray &m_data;
+    const QVector<JsonSpan> &m_spans;
+    const int m_first;
+    const int m_last;
+    TaskRecord *const m_records;
+    QAtomicInt &m_errorCount;
+};
+
+}
+
+// Reads the tasks array. Finding where each task starts and ends is cheap, so that's done here
+// and the actual parsing is split across threads.
+static bool readTaskRecords(JsonStreamReader &reader, const QByteArray &data, int maxThreads,
+                            QVector<TaskRecord> &records)
+{
+    QVector<JsonSpan> spans;
+    while (nextObjectInArray(reader)) {
+        JsonSpan span;
+        span.begin = reader.offset() - 1; // The opening brace
+        reader.skipContainer();
+        span.end = reader.offset();
+        spans << span;
+    }
+
+    if (reader.hasError())
+        return false;
+
+    records.resize(spans.count());
+    if (maxThreads <= 0)
+        maxThreads = QThread::idealThreadCount();
+    const int numThreads = qBound(1, spans.count() / MinimumTasksPerParserThread, qMax(1, maxThreads));
+
+    QAtomicInt errorCount;
+    if (numThreads == 1) {
+        TaskRecordParser parser(data, spans, 0, spans.count(), records.data(), errorCount);
+        parser.run();
+    } else {
+        QThreadPool pool;
+        pool.setMaxThreadCount(numThreads);
+        const int chunkSize = (spans.count() + numThreads - 1) / numThreads;
+        for (int first = 0; first < spans.count(); first += chunkSize) {
+            const int last = qMin(first + chunkSize, spans.count());
+            pool.start(new TaskRecordParser(data, spans, first, last, records.data(), errorCount));
+        }
+        pool.waitForDone();
+    }
+
+    return errorCount.load() == 0;
 }
 
 Storage::Data JsonStorage::deserializeJsonData(const QByteArray &serializedData,
                                                QString &errorMsg, Kernel *kernel)
+{
+    return deserializeJsonData(serializedData, errorMsg, kernel, 0);
+}
+
+Storage::Data JsonStorage::deserializeJsonData(const QByteArray &serializedData,
+                                               QString &errorMsg, Kernel *kernel, int maxThreads)
+{
+    Data result;
+    errorMsg.clear();
+    JsonStreamReader reader(serializedData);
+    if (reader.readNext() != JsonStreamReader::BeginObject) {
+        errorMsg = reader.hasError() ? reader.errorString() : QStringLiteral("expected a json object");
+        return result;
+    }
+
+    // Tasks and tags are created as they're read, without building the whole document in memory first
+    while (reader.readNext() == JsonStreamReader::Name) {
+        if (reader.isName("JsonSerializerVersion")) {
+            readScalar(reader);
+            const int serializerVersion = reader.integerValue();
+            if (serializerVersion > result.serializerVersion) {
+                errorMsg = QString("Found serializer version %1 which is bigger than %2. Update your application").arg(serializerVersion).arg(result.serializerVersion);
+                return Data();
+            }
+        } else if (reader.isName("instanceId")) {
+            readScalar(reader);
+            result.instanceId = reader.stringValue().toUtf8();
+        } else if (reader.isName("tags")) {
+            if (!enterArray(reader))
+                continue;
+            while (nextObjectInArray(reader)) {
+                TagRecord record;
+                readTagRecord(reader, record);
+                Tag::Ptr tag = Tag::Ptr(new Tag(kernel, QString()));
+                tag->fromRecord(record);
+                if (!tag->name().isEmpty() && !Storage::itemListContains<Tag::Ptr>(result.tags, tag)) {
+                    if (kernel) // Reuse tags from given storage
+                        tag = kernel->storage()->tag(tag->name());
+                    result.tags << tag;
+                }
+            }
+        } else if (reader.isName("tasks")) {
+            if (!enterArray(reader))
+                continue;
+
+            QVector<TaskRecord> records;
+            if (!readTaskRecords(reader, serializedData, maxThreads, records)) {
+                errorMsg = reader.hasError() ? reader.errorString() : QStringLiteral("invalid task");
+                return Data();
+            }
+
+            // QObjects are created here, in one go
+            QList<Task::Ptr> tasks;
+            tasks.reserve(records.count());
+            foreach (const TaskRecord &record, records) {
+                Task::Ptr task = Task::createTask(kernel);
+                Q_ASSERT(task);
+                task->fromRecord(record);
+                tasks << task;
+            }
+            result.tasks << tasks;
+        } else {
+            reader.skipValue();
+        }
+    }
+
+    if (reader.hasError() || reader.tokenType() != JsonStreamReader::EndObject) {
+        errorMsg = reader.hasError() ? reader.errorString() : QStringLiteral("unterminated json object");
+        return Data();
+    }
+
+    if (result.instanceId.isEmpty())
+        result.instanceId = QUuid::createUuid().toByteArray();
+
+    return result;
+}
+
+Storage::Data JsonStorage::deserializeJsonDocument(const QByteArray &serializedData,
+                                                   QString &errorMsg, Kernel *kernel)
 {
     Data result;
     errorMsg.clear();
@@ -89,6 +417,7 @@ void JsonStorage::load_impl()
     qDebug() << "JsonStorage::load_impl Loading from" << dataFileName;
     if (!QFile::exists(dataFileName)) { // Nothing to load
         qDebug() << "JsonStorage::load_impl():" << dataFileName << "does not exist yet.";
+        replayJournal();
         return;
     }
 
@@ -104,10 +433,11 @@ void JsonStorage::load_impl()
     file.close();
 
     QString errorMsg;
-    Data data = deserializeJsonData(serializedData, errorMsg, m_kernel);
+    Data data = BinarySerializer::isBinaryData(serializedData) ? BinarySerializer::deserialize(serializedData, errorMsg, m_kernel)
+                                                               : deserializeJsonData(serializedData, errorMsg, m_kernel);
 
     if (!errorMsg.isEmpty()) {
-        qWarning() << "Error parsing json file" << dataFileName;
+        qWarning() << "Error parsing data file" << dataFileName;
         qWarning() << "Error was" << errorMsg;
         qFatal("Bailing out");
         return;
@@ -117,51 +447,455 @@ void JsonStorage::load_impl()
     m_data.instanceId = data.instanceId;
 
     m_data.tasks.clear();
-    for (int i = 0; i < data.tasks.count(); ++i) {
-        addTask(data.tasks.at(i)); // don't add to m_tasks directly. addTask() does some connects
+    addTasks(data.tasks); // don't add to m_tasks directly. addTasks() does some connects
+
+    m_snapshotSize = serializedData.size();
+    replayJournal();
+
+    m_archiveFileExists = QFile::exists(archiveFileName());
+    m_archiveLoaded = !m_archiveFileExists;
+    if (m_archiveFileExists) {
+        readArchiveSummary();
+        if (!archivingEnabled()) { // It was disabled meanwhile, the next snapshot brings the tasks back
+            loadArchive_impl();
+            materializeAllTasks();
+        }
+    }
+}
+
+void JsonStorage::readArchiveSummary()
+{
+    QFile file(archiveFileName());
+    QVariantMap summary;
+    if (!file.open(QIODevice::ReadOnly) || !deserializeArchive(&file, summary, Q_NULLPTR)) {
+        qWarning() << "Could not read archive" << archiveFileName() << file.errorString();
+        return;
+    }
+
+    // The archived tasks aren't in memory but still count for their tags
+    foreach (const QVariant &t, summary.value("tags").toList()) {
+        const QVariantMap tagSummary = t.toMap();
+        Tag::Ptr tag = tagForUuid(tagSummary.value("uuid").toString());
+        if (tag) { // Otherwise it was removed
+            addDormantTagCount(tag->name(), tagSummary.value("count").toInt());
+            m_archivedTags << tagSummary;
+        }
+    }
+
+    qDebug() << "JsonStorage: Left" << summary.value("taskCount").toInt() << "tasks in the archive";
+}
+
+void JsonStorage::loadArchive_impl()
+{
+    if (m_archiveLoaded)
+        return;
+
+    m_archiveLoaded = true;
+
+    // The records replace the summary counts. Tags might have been renamed meanwhile,
+    // but they keep the uuid
+    QHash<QString, QString> currentTagNames; // lower-cased archived name -> current name
+    foreach (const QVariant &t, m_archivedTags) {
+        const QVariantMap tagSummary = t.toMap();
+        Tag::Ptr tag = tagForUuid(tagSummary.value("uuid").toString());
+        if (tag) {
+            addDormantTagCount(tag->name(), -tagSummary.value("count").toInt());
+            currentTagNames.insert(tagSummary.value("name").toString().toLower(), tag->name());
+        }
+    }
+    m_archivedTags.clear();
+
+    QVariantMap summary;
+    QVector<TaskRecord> records;
+    if (!readArchive(archiveFileName(), summary, records))
+        return;
+
+    // No Task objects are created here, the archived tasks stay dormant until shown
+    QStringList dueDatedUuids;
+    for (int i = 0; i < records.count(); ++i) {
+        m_archiveFileUuids.insert(Syncable::keyForUuid(records.at(i).uuid));
+        if (records.at(i).hasDueDate)
+            dueDatedUuids << records.at(i).uuid;
+        QStringList tags;
+        foreach (const QString &tagName, records.at(i).tags) {
+            const QString name = currentTagNames.value(tagName.toLower());
+            if (!name.isEmpty()) // Otherwise the tag was removed
+                tags << name;
+        }
+        records[i].tags = tags;
+    }
+
+    const int dormantCount = dormantTaskCount();
+    addDormantTasks(records); // Skips the ones in the data file, they're newer
+    foreach (const QString &uuid, dueDatedUuids) // Archived by older versions, they must be staged when due
+        materializeTask(uuid);
+    qDebug() << "JsonStorage: Loaded" << dormantTaskCount() - dormantCount << "tasks from the archive";
+}
+
+bool JsonStorage::archiveLoaded() const
+{
+    return m_archiveLoaded;
+}
+
+QString JsonStorage::archiveFileName() const
+{
+    return archiveFileName(m_runtimeConfiguration.dataFileName());
+}
+
+QString JsonStorage::archiveFileName(const QString &dataFileName)
+{
+    return dataFileName + ".archive";
+}
+
+bool JsonStorage::readArchive(const QString &fileName, QVariantMap &summary, QVector<TaskRecord> &records)
+{
+    QFile file(fileName);
+    QByteArray tasksData;
+    if (!file.open(QIODevice::ReadOnly) || !deserializeArchive(&file, summary, &tasksData)) {
+        qWarning() << "Could not read archive" << fileName << file.errorString();
+        return false;
+    }
+
+    QString errorMsg;
+    QByteArray instanceId;
+    QVector<TagRecord> tagRecords;
+    if (!BinarySerializer::deserializeRecords(tasksData, errorMsg, instanceId, tagRecords, records)) {
+        qWarning() << "Error parsing archive" << fileName << errorMsg;
+        return false;
+    }
+
+    return true;
+}
+
+bool JsonStorage::archivingEnabled() const
+{
+    return m_runtimeConfiguration.archiveAfterDays() > 0;
+}
+
+bool JsonStorage::archiveInMemory() const
+{
+    // Then the archive file is rewritten with every snapshot
+    return m_archiveLoaded && (archivingEnabled() || m_archiveFileExists);
+}
+
+bool JsonStorage::isArchivable(const Task::Ptr &task, const QDateTime &cutoff) const
+{
+    // Tasks with a due date stay, they're staged when it arrives
+    return !task->staged() && task->status() != TaskStarted && !task->dueDate().isValid()
+           && task->modificationDate() < cutoff;
+}
+
+Tag::Ptr JsonStorage::tagForUuid(const QString &uuid) const
+{
+    foreach (const Tag::Ptr &tag, m_data.tags) {
+        if (tag->uuid() == uuid)
+            return tag;
     }
+
+    return Tag::Ptr();
 }
 
 void JsonStorage::save_impl()
 {
-    QByteArray serializedData = serializeToJsonData(m_data);
-    QString tmpDataFileName = m_runtimeConfiguration.dataFileName() + "~";;
+    // Whatever changed must be serialized again
+    if (m_fullSaveRequired)
+        m_taskJsonCache.clear();
+
+    foreach (const QString &uid, m_removedTaskUids)
+        m_taskJsonCache.remove(Syncable::keyForUuid(uid));
+
+    QHash<QUuid, QWeakPointer<Task> >::const_iterator it;
+    for (it = m_changedTasks.cbegin(); it != m_changedTasks.cend(); ++it)
+        m_taskJsonCache.remove(it.key());
+
+    // Journal records can't reach tasks living in the archive file, so while those are
+    // in memory every save is a snapshot
+    const bool canAppend = m_runtimeConfiguration.journalEnabled() && !m_fullSaveRequired
+                           && !(archiveInMemory() && m_archiveFileExists)
+                           && QFile::exists(m_runtimeConfiguration.dataFileName());
+    if (canAppend) {
+        appendToJournal();
+        if (journalNeedsCompaction())
+            m_compactionTimer.start();
+    } else {
+        saveSnapshot();
+    }
+
+    clearPendingChanges();
+}
+
+QString JsonStorage::journalFileName() const
+{
+    return journalFileName(m_runtimeConfiguration.dataFileName());
+}
+
+QString JsonStorage::journalFileName(const QString &dataFileName)
+{
+    return dataFileName + ".journal";
+}
+
+void JsonStorage::appendToJournal()
+{
+    QByteArray records;
+    if (m_tagsChanged) {
+        // Tags are few, so we always store all of them
+        QVariantList tagsVariant;
+        for (int i = 0; i < m_data.tags.count(); ++i)
+            tagsVariant << m_data.tags.at(i)->toJson();
+
+        QVariantMap record;
+        record.insert("op", "tags");
+        record.insert("tags", tagsVariant);
+        records += journalRecord(record);
+    }
+
+    foreach (const QString &uid, m_removedTaskUids) {
+        QVariantMap record;
+        record.insert("op", "removeTask");
+        record.insert("uuid", uid);
+        records += journalRecord(record);
+    }
+
+    // New tasks are inserted at their row when replaying, so write them in row order:
+    // every row before the one being inserted is then already in place
+    QHash<Task*, int> changedTasks;
+    foreach (const QWeakPointer<Task> &weakTask, m_changedTasks) {
+        Task::Ptr task = weakTask.toStrongRef();
+        if (task)
+            changedTasks.insert(task.data(), -1);
+    }
+
+    QMap<int, Task::Ptr> changedTasksByRow;
+    for (int i = 0; i < m_data.tasks.count() && changedTasksByRow.count() < changedTasks.count(); ++i) {
+        if (changedTasks.contains(m_data.tasks.at(i).data()))
+            changedTasksByRow.insert(i, m_data.tasks.at(i));
+    }
 
-    QFile temporaryFile(tmpDataFileName); // not using QTemporaryFile so the backup stays next to the main one
-    if (!temporaryFile.open(QIODevice::WriteOnly)) {
-        qWarning() << "Could not open" << tmpDataFileName << "for writing"
-                   << temporaryFile.errorString() << temporaryFile.error();
+    QMap<int, Task::Ptr>::const_iterator it;
+    for (it = changedTasksByRow.cbegin(); it != changedTasksByRow.cend(); ++it) {
+        QVariantMap record;
+        record.insert("op", "task");
+        record.insert("row", it.key());
+        record.insert("task", taskJson(it.value()));
+        records += journalRecord(record);
+    }
+
+    if (records.isEmpty())
         return;
+
+    ++m_pendingWrites;
+    m_journalSize += records.size();
+    QMetaObject::invokeMethod(writer(), "appendToJournal", Qt::QueuedConnection,
+                              Q_ARG(QByteArray, records));
+}
+
+void JsonStorage::replayJournal()
+{
+    if (QFile::exists(journalFileName())) {
+        replayJournalFile(journalFileName());
+        m_journalSize = QFileInfo(journalFileName()).size();
     }
+}
 
-    const QString dataFileName = m_runtimeConfiguration.dataFileName();
-    temporaryFile.write(serializedData, serializedData.count());
-    if (QFile::exists(dataFileName) && !QFile::remove(dataFileName)) {
-        qWarning() << "Could not update (remove error)" << dataFileName
-                   << "backup file is at" << tmpDataFileName;
+bool JsonStorage::journalNeedsCompaction() const
+{
+    return m_journalSize > qMax<qint64>(MinimumJournalSizeForCompaction, m_snapshotSize / 2);
+}
+
+void JsonStorage::compactJournal()
+{
+    if (m_journalSize > 0)
+        saveSnapshot();
+}
+
+void JsonStorage::saveSnapshot()
+{
+    // Only tasks that changed since the last save are serialized here, the rest comes from
+    // the cache and is implicitly shared with the writer thread
+    const bool splitArchive = archiveInMemory();
+    const QDateTime cutoff = archivingEnabled() ? QDateTime::currentDateTimeUtc().addDays(-m_runtimeConfiguration.archiveAfterDays())
+                                                : QDateTime();
+    QVariantList tasksVariant;
+    QVariantList archivedTasksVariant;
+    QVariantList unarchivedTasksVariant; // In the archive file, but not anymore
+    QHash<Tag*, int> archivedTagCounts;
+    tasksVariant.reserve(m_data.tasks.count());
+    for (int i = 0; i < m_data.tasks.count(); ++i) {
+        const Task::Ptr &task = m_data.tasks.at(i);
+        if (splitArchive && cutoff.isValid() && isArchivable(task, cutoff)) {
+            archivedTasksVariant << taskJson(task);
+            foreach (const TagRef &tagRef, task->tags()) {
+                Tag::Ptr tag = tagRef.tag();
+                if (tag)
+                    archivedTagCounts[tag.data()]++;
+            }
+        } else {
+            tasksVariant << taskJson(task);
+            if (splitArchive && m_archiveFileUuids.contains(task->uuidKey()))
+                unarchivedTasksVariant << tasksVariant.last();
+        }
+    }
+
+    // Dormant tasks were archived already and have no Task to serialize
+    QVariantList &dormantTasksVariant = splitArchive ? archivedTasksVariant : tasksVariant;
+    foreach (const TaskRecord &record, dormantTasks()) {
+        dormantTasksVariant << Task::recordToJson(record);
+        if (!splitArchive)
+            continue;
+        foreach (const QString &tagName, record.tags) {
+            Tag::Ptr tag = this->tag(tagName, /*create=*/ false);
+            if (tag)
+                archivedTagCounts[tag.data()]++;
+        }
+    }
+
+    ++m_pendingWrites;
+    m_journalSize = 0;
+    m_compactionTimer.stop();
+    if (!splitArchive) {
+        QMetaObject::invokeMethod(writer(), "writeSnapshot", Qt::QueuedConnection,
+                                  Q_ARG(QVariantMap, toJsonVariantMap(m_data, tasksVariant)));
         return;
     }
 
-    if (!temporaryFile.copy(dataFileName)) {
-        qWarning() << "Could not update" << dataFileName
-                   << "backup file is at" << tmpDataFileName;
+    QVariantList tagsSummary;
+    QHash<Tag*, int>::const_iterator it;
+    for (it = archivedTagCounts.cbegin(); it != archivedTagCounts.cend(); ++it) {
+        QVariantMap tagSummary;
+        tagSummary.insert("uuid", it.key()->uuid());
+        tagSummary.insert("name", it.key()->name());
+        tagSummary.insert("count", it.value());
+        tagsSummary << tagSummary;
+    }
+
+    QVariantMap summary;
+    summary.insert("taskCount", archivedTasksVariant.count());
+    summary.insert("tags", tagsSummary);
+
+    // If the archive can't be written it's kept as it was, so assume it's still there.
+    // If it is, whatever it had that's not archived anymore went to the data file first.
+    m_archiveFileExists = m_archiveFileExists || !archivedTasksVariant.isEmpty();
+    m_archiveFileUuids.clear();
+    foreach (const QVariant &t, archivedTasksVariant)
+        m_archiveFileUuids.insert(Syncable::keyForUuid(t.toMap().value("uuid").toString()));
+    QMetaObject::invokeMethod(writer(), "writeSnapshotAndArchive", Qt::QueuedConnection,
+                              Q_ARG(QVariantMap, toJsonVariantMap(m_data, tasksVariant)),
+                              Q_ARG(QString, archiveFileName()),
+                              Q_ARG(QVariantMap, toJsonVariantMap(m_data, archivedTasksVariant)),
+                              Q_ARG(QVariantMap, summary),
+                              Q_ARG(QVariantList, unarchivedTasksVariant));
+}
+
+void JsonStorage::onSnapshotWritten(bool success, qint64 size, qint64 bytesWritten)
+{
+    --m_pendingWrites;
+    m_lastSaveBytesWritten = bytesWritten;
+    m_totalBytesWritten += bytesWritten;
+    if (success)
+        m_snapshotSize = size;
+
+    // The pending changes were already cleared, so the journal alone can't describe them
+    onWriteFinished(success);
+}
+
+void JsonStorage::onJournalAppended(bool success, qint64 bytesWritten)
+{
+    --m_pendingWrites;
+    m_lastSaveBytesWritten = bytesWritten;
+    m_totalBytesWritten += bytesWritten;
+    // Don't lose the changes, write everything instead
+    onWriteFinished(success);
+}
+
+void JsonStorage::onArchiveRemoved()
+{
+    // A snapshot queued since then may be writing a new archive
+    if (m_archiveFileUuids.isEmpty())
+        m_archiveFileExists = false;
+}
+
+void JsonStorage::onWriteFinished(bool success)
+{
+    if (success) {
+        m_failedWrites = 0;
+        m_retryTimer.stop();
+        emit saveFinished(true);
         return;
     }
+
+    m_fullSaveRequired = true;
+    ++m_failedWrites;
+    if (m_failedWrites == 1) // A disk that's full or read-only fails every write, say it once
+        emit saveFinished(false);
+
+    if (m_failedWrites <= MaximumWriteRetries) {
+        m_retryTimer.start(WriteRetryDelay << (m_failedWrites - 1));
+    } else if (m_failedWrites == MaximumWriteRetries + 1) {
+        qWarning() << "Giving up saving" << m_runtimeConfiguration.dataFileName()
+                   << "until something changes";
+    }
+}
+
+bool JsonStorage::savingInProgress() const
+{
+    return Storage::savingInProgress() || m_pendingWrites > 0;
+}
+
+qint64 JsonStorage::lastSaveBytesWritten() const
+{
+    return m_lastSaveBytesWritten;
+}
+
+qint64 JsonStorage::totalBytesWritten() const
+{
+    return m_totalBytesWritten;
+}
+
+QVariantMap JsonStorage::taskJson(const Task::Ptr &task)
+{
+    const QUuid key = task->uuidKey();
+    QHash<QUuid, QVariantMap>::const_iterator it = m_taskJsonCache.constFind(key);
+    if (it != m_taskJsonCache.cend())
+        return it.value();
+
+    const QVariantMap json = task->toJson();
+    m_taskJsonCache.insert(key, json);
+    return json;
+}
+
+StorageWriter *JsonStorage::writer()
+{
+    if (!m_writer) {
+        m_writer = new StorageWriter(m_runtimeConfiguration, journalFileName());
+        m_writer->moveToThread(&m_writerThread);
+        connect(m_writer, &StorageWriter::snapshotWritten, this, &JsonStorage::onSnapshotWritten);
+        connect(m_writer, &StorageWriter::journalAppended, this, &JsonStorage::onJournalAppended);
+        connect(m_writer, &StorageWriter::archiveRemoved, this, &JsonStorage::onArchiveRemoved);
+        m_writerThread.setObjectName("Flow storage writer");
+        m_writerThread.start();
+    }
+
+    return m_writer;
 }
 
 QVariantMap JsonStorage::toJsonVariantMap(const Data &data)
 {
-    QVariantMap map;
     QVariantList tasksVariant;
+    for (int i = 0; i < data.tasks.count(); ++i) {
+        tasksVariant << data.tasks.at(i)->toJson();
+    }
+
+    return toJsonVariantMap(data, tasksVariant);
+}
+
+QVariantMap JsonStorage::toJsonVariantMap(const Data &data, const QVariantList &tasksVariant)
+{
+    QVariantMap map;
     QVariantList tagsVariant;
     for (int i = 0; i < data.tags.count(); ++i) {
         tagsVariant << data.tags.at(i)->toJson();
     }
 
-    for (int i = 0; i < data.tasks.count(); ++i) {
-        tasksVariant << data.tasks.at(i)->toJson();
-    }
-
     map.insert("instanceId", data.instanceId);
     map.insert("tags", tagsVariant);
     map.insert("tasks", tasksVariant);
@@ -175,3 +909,37 @@ QByteArray JsonStorage::serializeToJsonData(const Data &data)
     QJsonDocument document = QJsonDocument::fromVariant(toJsonVariantMap(data));
     return document.toJson();
 }
+
+QByteArray JsonStorage::serializeToBinaryData(const Data &data)
+{
+    return BinarySerializer::serialize(toJsonVariantMap(data));
+}
+
+QByteArray JsonStorage::serializeArchive(const QVariantMap &root, const QVariantMap &summary)
+{
+    QByteArray result;
+    QDataStream stream(&result, QIODevice::WriteOnly);
+    stream << quint32(ArchiveMagic)
+           << QJsonDocument::fromVariant(summary).toJson(QJsonDocument::Compact)
+           << qCompress(BinarySerializer::serialize(root));
+    return result;
+}
+
+bool JsonStorage::deserializeArchive(QIODevice *device, QVariantMap &summary, QByteArray *tasksData)
+{
+    QDataStream stream(device);
+    quint32 magic = 0;
+    QByteArray summaryData;
+    stream >> magic >> summaryData;
+    if (magic != ArchiveMagic || stream.status() != QDataStream::Ok)
+        return false;
+
+    summary = QJsonDocument::fromJson(summaryData).toVariant().toMap();
+    if (tasksData) {
+        QByteArray compressedData;
+        stream >> compressedData;
+        *tasksData = qUncompress(compressedData);
+    }
+
+    return stream.status() == QDataStream::Ok;
+}
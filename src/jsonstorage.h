@@ -23,7 +23,12 @@
 #include "storage.h"
 #include "runtimeconfiguration.h"
 
+#include <QThread>
+#include <QSet>
+
 class Kernel;
+class StorageWriter;
+class QIODevice;
 
 class JsonStorage : public Storage
 {
@@ -34,15 +39,77 @@ public:
 
     static Data deserializeJsonData(const QByteArray &serializedData, QString &error,
                                     Kernel *kernel);
+    // Big task arrays are parsed by up to maxThreads worker threads, 0 means QThread::idealThreadCount().
+    // Tasks are still created in the calling thread.
+    static Data deserializeJsonData(const QByteArray &serializedData, QString &error,
+                                    Kernel *kernel, int maxThreads);
+    // Goes through QJsonDocument and QVariantMap, slower and heavier than deserializeJsonData().
+    // Only kept as reference for the benchmarks.
+    static Data deserializeJsonDocument(const QByteArray &serializedData, QString &error,
+                                        Kernel *kernel);
     static QByteArray serializeToJsonData(const Storage::Data &);
+    static QByteArray serializeToBinaryData(const Storage::Data &);
+
+    // The archive file starts with a small uncompressed summary (task count and the uuid, name and
+    // task count of each tag) followed by the compressed tasks, so the summary can be read alone.
+    static QByteArray serializeArchive(const QVariantMap &root, const QVariantMap &summary);
+    static bool deserializeArchive(QIODevice *device, QVariantMap &summary, QByteArray *tasksData);
+    // Reads the whole archive file. Tag names in the records are the ones the summary had.
+    static bool readArchive(const QString &fileName, QVariantMap &summary, QVector<TaskRecord> &records);
+
+    QString journalFileName() const;
+    static QString journalFileName(const QString &dataFileName);
+    bool savingInProgress() const Q_DECL_OVERRIDE;
+    QString archiveFileName() const;
+    static QString archiveFileName(const QString &dataFileName);
+    bool archiveLoaded() const Q_DECL_OVERRIDE;
+
+    // I/O done by the last finished save (snapshot or journal append) and since startup
+    qint64 lastSaveBytesWritten() const;
+    qint64 totalBytesWritten() const;
 
 protected:
     void load_impl() Q_DECL_OVERRIDE;
     void save_impl() Q_DECL_OVERRIDE;
+    void loadArchive_impl() Q_DECL_OVERRIDE;
+
+private Q_SLOTS:
+    void compactJournal();
+    void onSnapshotWritten(bool success, qint64 size, qint64 bytesWritten);
+    void onJournalAppended(bool success, qint64 bytesWritten);
+    void onArchiveRemoved();
 
 private:
     static QVariantMap toJsonVariantMap(const Storage::Data &);
+    static QVariantMap toJsonVariantMap(const Storage::Data &, const QVariantList &tasksVariant);
+    QVariantMap taskJson(const Task::Ptr &task);
+    StorageWriter *writer();
+    void saveSnapshot();
+    void appendToJournal();
+    void onWriteFinished(bool success);
+    void replayJournal();
+    bool journalNeedsCompaction() const;
+    bool archivingEnabled() const;
+    bool archiveInMemory() const;
+    bool isArchivable(const Task::Ptr &task, const QDateTime &cutoff) const;
+    void readArchiveSummary();
+    Tag::Ptr tagForUuid(const QString &uuid) const;
     const RuntimeConfiguration m_runtimeConfiguration;
+    QTimer m_compactionTimer;
+    qint64 m_snapshotSize;
+    qint64 m_journalSize;
+    QThread m_writerThread;
+    StorageWriter *m_writer;
+    int m_pendingWrites;
+    qint64 m_lastSaveBytesWritten;
+    qint64 m_totalBytesWritten;
+    QHash<QUuid, QVariantMap> m_taskJsonCache; // keyed by Syncable::uuidKey(), so taking a snapshot is cheap
+    bool m_archiveLoaded;
+    bool m_archiveFileExists;
+    QVariantList m_archivedTags; // Summary of the archive file, counted in the tags until it's loaded
+    QSet<QUuid> m_archiveFileUuids; // Tasks written to the archive file, to know which left it
+    QTimer m_retryTimer;
+    int m_failedWrites; // Consecutive ones, retries back off and stop after MaximumWriteRetries
 };
 
 #endif
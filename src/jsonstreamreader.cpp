@@ -0,0 +1,331 @@
+/*
+  This file is part of Flow.
+
+  Copyright (C) 2015 Sérgio Martins <iamsergio@gmail.com>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "jsonstreamreader.h"
+
+#include <string.h>
+
+JsonStreamReader::JsonStreamReader(const QByteArray &data)
+    : m_begin(data.constData())
+    , m_end(data.constData() + data.size())
+    , m_pos(data.constData())
+    , m_tokenType(NoToken)
+    , m_tokenStart(Q_NULLPTR)
+    , m_tokenLength(0)
+    , m_tokenHasEscapes(false)
+    , m_boolValue(false)
+{
+}
+
+JsonStreamReader::TokenType JsonStreamReader::readNext()
+{
+    if (m_tokenType == Invalid || m_tokenType == EndDocument)
+        return m_tokenType;
+
+    skipSeparators();
+    if (m_pos == m_end)
+        return m_tokenType = EndDocument;
+
+    switch (*m_pos) {
+    case '{':
+        ++m_pos;
+        return m_tokenType = BeginObject;
+    case '}':
+        ++m_pos;
+        return m_tokenType = EndObject;
+    case '[':
+        ++m_pos;
+        return m_tokenType = BeginArray;
+    case ']':
+        ++m_pos;
+        return m_tokenType = EndArray;
+    case '"':
+        if (!readString())
+            return setError(QStringLiteral("unterminated string"));
+
+        // A string followed by ':' is the name of an object member
+        while (m_pos != m_end && (*m_pos == ' ' || *m_pos == '\n' || *m_pos == '\r' || *m_pos == '\t'))
+            ++m_pos;
+        if (m_pos != m_end && *m_pos == ':') {
+            ++m_pos;
+            return m_tokenType = Name;
+        }
+        return m_tokenType = String;
+    case 't':
+        return readLiteral("true", 4, Bool, true);
+    case 'f':
+        return readLiteral("false", 5, Bool, false);
+    case 'n':
+        return readLiteral("null", 4, Null, false);
+    default:
+        if (*m_pos == '-' || (*m_pos >= '0' && *m_pos <= '9'))
+            return readNumber();
+        return setError(QStringLiteral("unexpected character"));
+    }
+}
+
+JsonStreamReader::TokenType JsonStreamReader::tokenType() const
+{
+    return m_tokenType;
+}
+
+bool JsonStreamReader::isName(const char *name) const
+{
+    return m_tokenType == Name && !m_tokenHasEscapes && int(strlen(name)) == m_tokenLength
+           && memcmp(name, m_tokenStart, m_tokenLength) == 0;
+}
+
+static int hexValue(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+QString JsonStreamReader::stringValue() const
+{
+    if (m_tokenType != Name && m_tokenType != String)
+        return QString();
+
+    if (!m_tokenHasEscapes)
+        return QString::fromUtf8(m_tokenStart, m_tokenLength);
+
+    QString result;
+    result.reserve(m_tokenLength);
+    const char *runStart = m_tokenStart;
+    const char *end = m_tokenStart + m_tokenLength;
+    const char *p = m_tokenStart;
+    while (p < end) {
+        if (*p != '\\') {
+            ++p;
+            continue;
+        }
+
+        result += QString::fromUtf8(runStart, p - runStart);
+        ++p; // readString() guarantees there's a character after the backslash
+        switch (*p) {
+        case 'b': result += QLatin1Char('\b'); break;
+        case 'f': result += QLatin1Char('\f'); break;
+        case 'n': result += QLatin1Char('\n'); break;
+        case 'r': result += QLatin1Char('\r'); break;
+        case 't': result += QLatin1Char('\t'); break;
+        case 'u': {
+            ushort code = 0;
+            int i = 1;
+            for (; i <= 4 && p + i < end; ++i) {
+                const int digit = hexValue(p[i]);
+                if (digit < 0)
+                    break;
+                code = (code << 4) | digit;
+            }
+            // Surrogate pairs arrive as two escapes and end up as two utf-16 code units, which is what QString wants
+            result += QChar(code);
+            p += i - 1;
+            break;
+        }
+        default: // '"', '\\' and '/'
+            result += QLatin1Char(*p);
+            break;
+        }
+        ++p;
+        runStart = p;
+    }
+
+    result += QString::fromUtf8(runStart, end - runStart);
+    return result;
+}
+
+qint64 JsonStreamReader::integerValue() const
+{
+    switch (m_tokenType) {
+    case Number: {
+        bool ok = false;
+        const QByteArray number = QByteArray::fromRawData(m_tokenStart, m_tokenLength);
+        const qint64 value = number.toLongLong(&ok);
+        return ok ? value : qint64(number.toDouble());
+    }
+    case Bool:
+        return m_boolValue ? 1 : 0;
+    case String:
+        return stringValue().toLongLong();
+    default:
+        return 0;
+    }
+}
+
+double JsonStreamReader::doubleValue() const
+{
+    switch (m_tokenType) {
+    case Number:
+        return QByteArray::fromRawData(m_tokenStart, m_tokenLength).toDouble();
+    case Bool:
+        return m_boolValue ? 1 : 0;
+    case String:
+        return stringValue().toDouble();
+    default:
+        return 0;
+    }
+}
+
+bool JsonStreamReader::boolValue() const
+{
+    switch (m_tokenType) {
+    case Bool:
+        return m_boolValue;
+    case Number:
+        return doubleValue() != 0;
+    case String: {
+        const QString value = stringValue();
+        return !value.isEmpty() && value != QLatin1String("0") && value != QLatin1String("false");
+    }
+    default:
+        return false;
+    }
+}
+
+void JsonStreamReader::skipValue()
+{
+    switch (readNext()) {
+    case BeginObject:
+    case BeginArray:
+        skipContainer();
+        break;
+    default:
+        break;
+    }
+}
+
+void JsonStreamReader::skipContainer()
+{
+    int depth = 1;
+    while (depth > 0) {
+        switch (readNext()) {
+        case BeginObject:
+        case BeginArray:
+            ++depth;
+            break;
+        case EndObject:
+        case EndArray:
+            --depth;
+            break;
+        case EndDocument:
+        case Invalid:
+            return;
+        default:
+            break;
+        }
+    }
+}
+
+bool JsonStreamReader::hasError() const
+{
+    return m_tokenType == Invalid;
+}
+
+QString JsonStreamReader::errorString() const
+{
+    return m_errorString;
+}
+
+int JsonStreamReader::offset() const
+{
+    return m_pos - m_begin;
+}
+
+JsonStreamReader::TokenType JsonStreamReader::setError(const QString &error)
+{
+    m_errorString = QStringLiteral("%1 at offset %2").arg(error).arg(m_pos - m_begin);
+    return m_tokenType = Invalid;
+}
+
+JsonStreamReader::TokenType JsonStreamReader::readLiteral(const char *literal, int length,
+                                                          TokenType type, bool value)
+{
+    if (m_end - m_pos < length || memcmp(m_pos, literal, length) != 0)
+        return setError(QStringLiteral("invalid literal"));
+
+    m_pos += length;
+    m_boolValue = value;
+    return m_tokenType = type;
+}
+
+JsonStreamReader::TokenType JsonStreamReader::readNumber()
+{
+    m_tokenStart = m_pos;
+    while (m_pos != m_end) {
+        const char c = *m_pos;
+        if ((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E')
+            ++m_pos;
+        else
+            break;
+    }
+
+    m_tokenLength = m_pos - m_tokenStart;
+    m_tokenHasEscapes = false;
+    return m_tokenType = Number;
+}
+
+bool JsonStreamReader::readString()
+{
+    ++m_pos; // opening quote
+    m_tokenStart = m_pos;
+    m_tokenHasEscapes = false;
+    while (m_pos != m_end) {
+        const char *quote = static_cast<const char*>(memchr(m_pos, '"', m_end - m_pos));
+        if (!quote)
+            break;
+
+        // Count the backslashes right before the quote, an odd number means it's escaped
+        const char *p = quote;
+        while (p > m_tokenStart && *(p - 1) == '\\')
+            --p;
+        if (memchr(m_pos, '\\', quote - m_pos))
+            m_tokenHasEscapes = true;
+
+        m_pos = quote + 1;
+        if ((quote - p) % 2 == 0) {
+            m_tokenLength = quote - m_tokenStart;
+            return true;
+        }
+    }
+
+    m_pos = m_end;
+    return false;
+}
+
+void JsonStreamReader::skipSeparators()
+{
+    while (m_pos != m_end) {
+        switch (*m_pos) {
+        case ' ':
+        case '\n':
+        case '\r':
+        case '\t':
+        case ',':
+            ++m_pos;
+            break;
+        default:
+            return;
+        }
+    }
+}
@@ -0,0 +1,83 @@
+/*
+  This file is part of Flow.
+
+  Copyright (C) 2015 Sérgio Martins <iamsergio@gmail.com>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FLOW_JSONSTREAMREADER_H
+#define FLOW_JSONSTREAMREADER_H
+
+#include <QByteArray>
+#include <QString>
+
+// Pull parser for utf-8 json. Unlike QJsonDocument it doesn't build a tree, the caller
+// reads tokens one by one and only materializes the values it's interested in.
+// The data must outlive the reader.
+class JsonStreamReader
+{
+public:
+    enum TokenType {
+        NoToken = 0,
+        BeginObject,
+        EndObject,
+        BeginArray,
+        EndArray,
+        Name, // Object member name, the value is the next token
+        String,
+        Number,
+        Bool,
+        Null,
+        EndDocument,
+        Invalid
+    };
+
+    explicit JsonStreamReader(const QByteArray &data);
+
+    TokenType readNext();
+    TokenType tokenType() const;
+
+    bool isName(const char *name) const; // Compares the current Name without decoding it
+    QString stringValue() const;
+    qint64 integerValue() const;
+    double doubleValue() const;
+    bool boolValue() const;
+
+    void skipValue(); // Call after a Name to skip its value, whatever it is
+    void skipContainer(); // Call after BeginObject or BeginArray to skip until the matching end
+
+    bool hasError() const;
+    QString errorString() const;
+    int offset() const; // Of the next character to read
+
+private:
+    TokenType setError(const QString &error);
+    TokenType readLiteral(const char *literal, int length, TokenType type, bool value);
+    TokenType readNumber();
+    bool readString();
+    void skipSeparators();
+
+    const char *const m_begin;
+    const char *const m_end;
+    const char *m_pos;
+    TokenType m_tokenType;
+    const char *m_tokenStart;
+    int m_tokenLength;
+    bool m_tokenHasEscapes;
+    bool m_boolValue;
+    QString m_errorString;
+};
+
+#endif
@@ -20,6 +20,7 @@
 #include "kernel.h"
 #include "controller.h"
 #include "jsonstorage.h"
+#include "sqlitestorage.h"
 #include "pluginmodel.h"
 #include "plugininterface.h"
 #include "settings.h"
@@ -35,6 +36,7 @@
 #include "taskcontextmenumodel.h"
 #include "extendedtagsmodel.h"
 #include "sortedtaskcontextmenumodel.h"
+#include "taskstatistics.h"
 
 #include <QStandardPaths>
 #include <QAbstractListModel>
@@ -76,6 +78,10 @@ static void registerQmlTypes()
                                                   1, 0, "ExtendedTagsModel",
                                                   "ExtendedTagsModel is not creatable");
 
+    qmlRegisterUncreatableType<TaskStatistics>("Controller",
+                                               1, 0, "TaskStatistics",
+                                               "TaskStatistics is not creatable");
+
     qmlRegisterUncreatableType<Controller>("Controller",
                                            1, 0, "Controller",
                                            "Controller is not creatable");
@@ -121,7 +127,7 @@ Kernel::~Kernel()
 Kernel::Kernel(const RuntimeConfiguration &config, QObject *parent)
     : QObject(parent)
     , m_runtimeConfiguration(config)
-    , m_storage(new JsonStorage(this, this))
+    , m_storage(createStorage())
     , m_qmlEngine(new QQmlEngine(0)) // leak the engine, no point in wasting shutdown time. Also we get a qmldebug server crash if it's parented to qApp, which Kernel is
     , m_settings(config.settings() ? config.settings() : new Settings(this))
     , m_controller(new Controller(m_qmlEngine->rootContext(), this, m_storage, m_settings, this))
@@ -161,6 +167,14 @@ Kernel::Kernel(const RuntimeConfiguration &config, QObject *parent)
     QMetaObject::invokeMethod(this, "dayChanged", Qt::QueuedConnection);
 }
 
+Storage *Kernel::createStorage()
+{
+    if (m_runtimeConfiguration.storageBackend() == RuntimeConfiguration::StorageBackendSqlite)
+        return new SqliteStorage(this, this);
+
+    return new JsonStorage(this, this);
+}
+
 Storage *Kernel::storage() const
 {
     return m_storage;
@@ -68,6 +68,7 @@ private Q_SLOTS:
 #endif
 
 private:
+    Storage *createStorage();
     void setupDayChangedTimer(const QDateTime &currentDateTime);
     void loadPlugins();
     void notifyPlugins(TaskStatus newStatus);
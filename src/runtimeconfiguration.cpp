@@ -24,6 +24,14 @@ RuntimeConfiguration::RuntimeConfiguration()
     , m_settings(0)
     , m_saveEnabled(true)
     , m_webDAVFileName("flow.dat")
+    , m_journalEnabled(true)
+    , m_storageBackend(StorageBackendFile)
+    , m_storageFormat(StorageFormatJson)
+    , m_backupGenerations(0)
+    , m_saveQuietPeriod(500)
+    , m_saveMaxStaleness(3000)
+    , m_rowLevelFiltering(false)
+    , m_archiveAfterDays(0)
 {
 }
 
@@ -76,3 +84,83 @@ void RuntimeConfiguration::setWebDAVFileName(const QString &name)
 {
     m_webDAVFileName = name;
 }
+
+bool RuntimeConfiguration::journalEnabled() const
+{
+    return m_journalEnabled;
+}
+
+void RuntimeConfiguration::setJournalEnabled(bool enabled)
+{
+    m_journalEnabled = enabled;
+}
+
+RuntimeConfiguration::StorageBackend RuntimeConfiguration::storageBackend() const
+{
+    return m_storageBackend;
+}
+
+void RuntimeConfiguration::setStorageBackend(StorageBackend backend)
+{
+    m_storageBackend = backend;
+}
+
+RuntimeConfiguration::StorageFormat RuntimeConfiguration::storageFormat() const
+{
+    return m_storageFormat;
+}
+
+void RuntimeConfiguration::setStorageFormat(StorageFormat format)
+{
+    m_storageFormat = format;
+}
+
+int RuntimeConfiguration::backupGenerations() const
+{
+    return m_backupGenerations;
+}
+
+void RuntimeConfiguration::setBackupGenerations(int generations)
+{
+    m_backupGenerations = generations;
+}
+
+int RuntimeConfiguration::saveQuietPeriod() const
+{
+    return m_saveQuietPeriod;
+}
+
+void RuntimeConfiguration::setSaveQuietPeriod(int msecs)
+{
+    m_saveQuietPeriod = msecs;
+}
+
+int RuntimeConfiguration::saveMaxStaleness() const
+{
+    return m_saveMaxStaleness;
+}
+
+void RuntimeConfiguration::setSaveMaxStaleness(int msecs)
+{
+    m_saveMaxStaleness = msecs;
+}
+
+bool RuntimeConfiguration::rowLevelFiltering() const
+{
+    return m_rowLevelFiltering;
+}
+
+void RuntimeConfiguration::setRowLevelFiltering(bool enabled)
+{
+    m_rowLevelFiltering = enabled;
+}
+
+int RuntimeConfiguration::archiveAfterDays() const
+{
+    return m_archiveAfterDays;
+}
+
+void RuntimeConfiguration::setArchiveAfterDays(int days)
+{
+    m_archiveAfterDays = days;
+}
@@ -27,6 +27,16 @@ class Settings;
 class RuntimeConfiguration
 {
 public:
+    enum StorageFormat {
+        StorageFormatJson = 0,
+        StorageFormatBinary
+    };
+
+    enum StorageBackend {
+        StorageBackendFile = 0, // JsonStorage
+        StorageBackendSqlite
+    };
+
     RuntimeConfiguration();
 
     void setDataFileName(const QString &);
@@ -44,12 +54,55 @@ public:
     QString webDAVFileName() const;
     void setWebDAVFileName(const QString &);
 
+    // When enabled saves append per-item records to a journal next to the data file,
+    // which is compacted into a full snapshot now and then. Default true.
+    bool journalEnabled() const;
+    void setJournalEnabled(bool);
+
+    // SqliteStorage imports the data file the first time. Default StorageBackendFile.
+    StorageBackend storageBackend() const;
+    void setStorageBackend(StorageBackend);
+
+    // Format of the data file when saving. Loading detects it. Default json.
+    StorageFormat storageFormat() const;
+    void setStorageFormat(StorageFormat);
+
+    // Number of previous data files kept as <data file>.1, .2, ... Default 0.
+    int backupGenerations() const;
+    void setBackupGenerations(int);
+
+    // Saves wait until changes stop for saveQuietPeriod() ms, but a change is never
+    // left unsaved for longer than saveMaxStaleness() ms. Defaults 500 and 3000.
+    int saveQuietPeriod() const;
+    void setSaveQuietPeriod(int msecs);
+    int saveMaxStaleness() const;
+    void setSaveMaxStaleness(int msecs);
+
+    // When a task's staged flag, status, tags, priority or due date change, the tasks model emits
+    // dataChanged for its row and the proxies re-evaluate only that row, instead of being
+    // invalidated as a whole. Default false.
+    bool rowLevelFiltering() const;
+    void setRowLevelFiltering(bool);
+
+    // Archived tasks not modified for this many days are moved to a compressed archive file next
+    // to the data file, which is only loaded when the archive is shown. 0 disables it. Default 0.
+    int archiveAfterDays() const;
+    void setArchiveAfterDays(int days);
+
 private:
     QString m_dataFileName;
     bool m_pluginsSupported;
     Settings *m_settings;
     bool m_saveEnabled;
     QString m_webDAVFileName;
+    bool m_journalEnabled;
+    StorageBackend m_storageBackend;
+    StorageFormat m_storageFormat;
+    int m_backupGenerations;
+    int m_saveQuietPeriod;
+    int m_saveMaxStaleness;
+    bool m_rowLevelFiltering;
+    int m_archiveAfterDays;
 };
 
 #endif
@@ -0,0 +1,504 @@
+/*
+  This file is part of Flow.
+
+  Copyright (C) 2015 Sérgio Martins <iamsergio@gmail.com>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "sqlitestorage.h"
+#include "jsonstorage.h"
+#include "binaryserializer.h"
+#include "kernel.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QSqlError>
+#include <QSqlQuery>
+
+enum {
+    SqliteSchemaVersion1 = 1
+};
+
+SqliteStorage::SqliteStorage(Kernel *kernel, QObject *parent)
+    : Storage(kernel, parent)
+    , m_runtimeConfiguration(kernel->runtimeConfiguration())
+    , m_connectionName(QString("flow-storage-%1").arg(quintptr(this)))
+    , m_firstPosition(0)
+    , m_lastPosition(-1)
+    , m_orderChanged(false)
+{
+    QAbstractItemModel *tasksModel = m_data.tasks;
+    connect(tasksModel, &QAbstractItemModel::rowsInserted, this, &SqliteStorage::onTaskRowsInserted);
+}
+
+SqliteStorage::~SqliteStorage()
+{
+    if (saveScheduled() && m_runtimeConfiguration.saveEnabled())
+        save_impl();
+
+    if (QSqlDatabase::contains(m_connectionName)) {
+        database().close();
+        QSqlDatabase::removeDatabase(m_connectionName);
+    }
+}
+
+QString SqliteStorage::databaseFileName() const
+{
+    const QFileInfo info(m_runtimeConfiguration.dataFileName());
+    return info.path() + "/" + info.completeBaseName() + ".sqlite";
+}
+
+QSqlDatabase SqliteStorage::database() const
+{
+    return QSqlDatabase::database(m_connectionName, /*open=*/ false);
+}
+
+bool SqliteStorage::exec(QSqlQuery &query) const
+{
+    if (!query.exec()) {
+        qWarning() << "SqliteStorage: query failed" << query.lastQuery() << query.lastError().text();
+        return false;
+    }
+
+    return true;
+}
+
+bool SqliteStorage::exec(const QString &statement) const
+{
+    QSqlQuery query(database());
+    if (!query.exec(statement)) {
+        qWarning() << "SqliteStorage: query failed" << statement << query.lastError().text();
+        return false;
+    }
+
+    return true;
+}
+
+bool SqliteStorage::openDatabase()
+{
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", m_connectionName);
+    db.setDatabaseName(databaseFileName());
+    if (!db.open()) {
+        qWarning() << "Could not open" << databaseFileName() << db.lastError().text();
+        return false;
+    }
+
+    return exec("PRAGMA journal_mode=WAL")
+        && exec("CREATE TABLE IF NOT EXISTS meta (key TEXT PRIMARY KEY, value BLOB)")
+        && exec("CREATE TABLE IF NOT EXISTS tags (position INTEGER PRIMARY KEY, uuid TEXT, name TEXT NOT NULL,"
+                " revision INTEGER, revisionOnWebDAVServer INTEGER)")
+        && exec("CREATE INDEX IF NOT EXISTS tags_name ON tags (name COLLATE NOCASE)")
+        && exec("CREATE TABLE IF NOT EXISTS tasks (uuid TEXT PRIMARY KEY, position INTEGER NOT NULL,"
+                " summary TEXT, description TEXT, staged INTEGER, priority INTEGER,"
+                " creationTimestamp INTEGER, modificationTimestamp INTEGER, lastPomodoroDate INTEGER,"
+                " dueDate INTEGER, revision INTEGER, revisionOnWebDAVServer INTEGER)")
+        && exec("CREATE INDEX IF NOT EXISTS tasks_position ON tasks (position)")
+        && exec("CREATE INDEX IF NOT EXISTS tasks_dueDate ON tasks (dueDate) WHERE dueDate IS NOT NULL")
+        && exec("CREATE TABLE IF NOT EXISTS task_tags (task_uuid TEXT NOT NULL, tag_name TEXT NOT NULL,"
+                " position INTEGER, PRIMARY KEY (task_uuid, position))")
+        && exec("CREATE INDEX IF NOT EXISTS task_tags_tag ON task_tags (tag_name COLLATE NOCASE)");
+}
+
+void SqliteStorage::load_impl()
+{
+    if (!openDatabase()) {
+        qFatal("Bailing out");
+        return;
+    }
+
+    QSqlQuery query(database());
+    query.prepare("SELECT value FROM meta WHERE key = 'instanceId'");
+    if (!exec(query) || !query.next()) {
+        // New database, import the data file, its journal and archive if there are any
+        const QString dataFileName = m_runtimeConfiguration.dataFileName();
+        if ((QFile::exists(dataFileName) || QFile::exists(JsonStorage::journalFileName(dataFileName))
+             || QFile::exists(JsonStorage::archiveFileName(dataFileName)))
+            && !migrateFromDataFile())
+            qFatal("Bailing out");
+        return;
+    }
+    m_data.instanceId = query.value(0).toByteArray();
+
+    query.prepare("SELECT uuid, name, revision, revisionOnWebDAVServer FROM tags ORDER BY position");
+    if (exec(query)) {
+        while (query.next()) {
+            TagRecord record;
+            record.uuid = query.value(0).toString();
+            record.name = query.value(1).toString();
+            record.revision = query.value(2).toInt();
+            record.revisionOnWebDAVServer = query.value(3).toInt();
+            Tag::Ptr tag = createTag(record.name, record.uuid);
+            if (tag)
+                tag->fromRecord(record);
+        }
+    }
+
+    QHash<QString, QStringList> tagsByTask;
+    query.prepare("SELECT task_uuid, tag_name FROM task_tags ORDER BY task_uuid, position");
+    if (exec(query)) {
+        while (query.next())
+            tagsByTask[query.value(0).toString()] << query.value(1).toString();
+    }
+
+    query.prepare("SELECT uuid, position, summary, description, staged, priority, creationTimestamp,"
+                  " modificationTimestamp, lastPomodoroDate, dueDate, revision, revisionOnWebDAVServer"
+                  " FROM tasks ORDER BY position");
+    if (!exec(query))
+        return;
+
+    QList<Task::Ptr> tasks;
+    bool first = true;
+    while (query.next()) {
+        TaskRecord record;
+        record.uuid = query.value(0).toString();
+        const qint64 position = query.value(1).toLongLong();
+        record.summary = query.value(2).toString();
+        record.description = query.value(3).toString();
+        record.staged = query.value(4).toBool();
+        record.priority = query.value(5).toInt();
+        record.creationTimestamp = query.value(6).toLongLong();
+        record.modificationTimestamp = query.value(7).toLongLong();
+        record.lastPomodoroTimestamp = query.value(8).toLongLong();
+        record.hasDueDate = !query.value(9).isNull();
+        record.dueDate = query.value(9).toLongLong();
+        record.revision = query.value(10).toInt();
+        record.revisionOnWebDAVServer = query.value(11).toInt();
+        record.tags = tagsByTask.value(record.uuid);
+
+        Task::Ptr task = Task::createTask(m_kernel);
+        task->fromRecord(record);
+        tasks << task;
+
+        if (first)
+            m_firstPosition = position;
+        m_lastPosition = position;
+        first = false;
+    }
+
+    addTasks(tasks);
+}
+
+bool SqliteStorage::migrateFromDataFile()
+{
+    const QString dataFileName = m_runtimeConfiguration.dataFileName();
+    if (QFile::exists(dataFileName)) {
+        QFile file(dataFileName);
+        if (!file.open(QIODevice::ReadOnly)) {
+            qWarning() << "Could not open data file" << dataFileName << file.errorString();
+            return false;
+        }
+
+        const QByteArray serializedData = file.readAll();
+        QString errorMsg;
+        Data data = BinarySerializer::isBinaryData(serializedData) ? BinarySerializer::deserialize(serializedData, errorMsg, m_kernel)
+                                                                   : JsonStorage::deserializeJsonData(serializedData, errorMsg, m_kernel);
+        if (!errorMsg.isEmpty()) {
+            qWarning() << "Error parsing data file" << dataFileName << errorMsg;
+            return false;
+        }
+
+        m_data.tags = data.tags;
+        m_data.instanceId = data.instanceId;
+        addTasks(data.tasks);
+    }
+
+    // JsonStorage might not have compacted its latest changes into the data file yet
+    const QString journalFileName = JsonStorage::journalFileName(dataFileName);
+    if (QFile::exists(journalFileName))
+        replayJournalFile(journalFileName);
+
+    const QString archiveFileName = JsonStorage::archiveFileName(dataFileName);
+    if (QFile::exists(archiveFileName) && !migrateArchive(archiveFileName))
+        return false;
+
+    // The data file, journal and archive are left alone, so going back to JsonStorage is still possible
+    qDebug() << "SqliteStorage: imported" << m_data.tasks.count() << "tasks from" << dataFileName;
+    return writeEverything();
+}
+
+bool SqliteStorage::migrateArchive(const QString &archiveFileName)
+{
+    QVariantMap summary;
+    QVector<TaskRecord> records;
+    if (!JsonStorage::readArchive(archiveFileName, summary, records))
+        return false;
+
+    // Tags might have been renamed since the archive was written, but they keep the uuid
+    QHash<QString, QString> currentTagNames; // lower-cased archived name -> current name
+    foreach (const QVariant &t, summary.value("tags").toList()) {
+        const QVariantMap tagSummary = t.toMap();
+        foreach (const Tag::Ptr &tag, m_data.tags) {
+            if (tag->uuid() == tagSummary.value("uuid").toString()) {
+                currentTagNames.insert(tagSummary.value("name").toString().toLower(), tag->name());
+                break;
+            }
+        }
+    }
+
+    QList<Task::Ptr> tasks;
+    foreach (TaskRecord record, records) {
+        if (taskForUuid(record.uuid)) // The data file's copy is newer
+            continue;
+
+        QStringList tags;
+        foreach (const QString &tagName, record.tags) {
+            const QString name = currentTagNames.value(tagName.toLower());
+            if (!name.isEmpty()) // Otherwise the tag was removed
+                tags << name;
+        }
+        record.tags = tags;
+
+        Task::Ptr task = Task::createTask(m_kernel);
+        task->fromRecord(record);
+        tasks << task;
+    }
+
+    addTasks(tasks);
+    return true;
+}
+
+void SqliteStorage::onTaskRowsInserted(const QModelIndex &, int first, int last)
+{
+    if (loadingInProgress())
+        return;
+
+    if (last == m_data.tasks.count() - 1) { // appended
+        for (int i = first; i <= last; ++i)
+            m_pendingPositions.insert(m_data.tasks.at(i)->uuid(), ++m_lastPosition);
+    } else if (first == 0) { // prepended
+        for (int i = last; i >= first; --i)
+            m_pendingPositions.insert(m_data.tasks.at(i)->uuid(), --m_firstPosition);
+    } else {
+        m_orderChanged = true;
+    }
+}
+
+bool SqliteStorage::writeTask(const Task::Ptr &task)
+{
+    const TaskRecord record = task->toRecord();
+    QSqlQuery query(database());
+    query.prepare("UPDATE tasks SET summary = :summary, description = :description, staged = :staged,"
+                  " priority = :priority, creationTimestamp = :creationTimestamp,"
+                  " modificationTimestamp = :modificationTimestamp, lastPomodoroDate = :lastPomodoroDate,"
+                  " dueDate = :dueDate, revision = :revision, revisionOnWebDAVServer = :revisionOnWebDAVServer"
+                  " WHERE uuid = :uuid");
+    query.bindValue(":uuid", record.uuid);
+    query.bindValue(":summary", record.summary);
+    query.bindValue(":description", record.description);
+    query.bindValue(":staged", record.staged);
+    query.bindValue(":priority", record.priority);
+    query.bindValue(":creationTimestamp", record.creationTimestamp);
+    query.bindValue(":modificationTimestamp", record.modificationTimestamp);
+    query.bindValue(":lastPomodoroDate", record.lastPomodoroTimestamp);
+    query.bindValue(":dueDate", record.hasDueDate ? QVariant(record.dueDate) : QVariant(QVariant::LongLong));
+    query.bindValue(":revision", record.revision);
+    query.bindValue(":revisionOnWebDAVServer", record.revisionOnWebDAVServer);
+    if (!exec(query))
+        return false;
+
+    if (query.numRowsAffected() == 0) { // New task
+        query.prepare("INSERT INTO tasks (uuid, position, summary, description, staged, priority,"
+                      " creationTimestamp, modificationTimestamp, lastPomodoroDate, dueDate, revision,"
+                      " revisionOnWebDAVServer) VALUES (:uuid, :position, :summary, :description, :staged,"
+                      " :priority, :creationTimestamp, :modificationTimestamp, :lastPomodoroDate, :dueDate,"
+                      " :revision, :revisionOnWebDAVServer)");
+        query.bindValue(":uuid", record.uuid);
+        query.bindValue(":position", m_pendingPositions.contains(record.uuid) ? m_pendingPositions.take(record.uuid)
+                                                                              : ++m_lastPosition);
+        query.bindValue(":summary", record.summary);
+        query.bindValue(":description", record.description);
+        query.bindValue(":staged", record.staged);
+        query.bindValue(":priority", record.priority);
+        query.bindValue(":creationTimestamp", record.creationTimestamp);
+        query.bindValue(":modificationTimestamp", record.modificationTimestamp);
+        query.bindValue(":lastPomodoroDate", record.lastPomodoroTimestamp);
+        query.bindValue(":dueDate", record.hasDueDate ? QVariant(record.dueDate) : QVariant(QVariant::LongLong));
+        query.bindValue(":revision", record.revision);
+        query.bindValue(":revisionOnWebDAVServer", record.revisionOnWebDAVServer);
+        if (!exec(query))
+            return false;
+    }
+
+    query.prepare("DELETE FROM task_tags WHERE task_uuid = ?");
+    query.addBindValue(record.uuid);
+    if (!exec(query))
+        return false;
+
+    query.prepare("INSERT INTO task_tags (task_uuid, tag_name, position) VALUES (?, ?, ?)");
+    for (int i = 0; i < record.tags.count(); ++i) {
+        query.addBindValue(record.uuid);
+        query.addBindValue(record.tags.at(i));
+        query.addBindValue(i);
+        if (!exec(query))
+            return false;
+    }
+
+    return true;
+}
+
+bool SqliteStorage::removeTaskRows(const QString &uuid)
+{
+    QSqlQuery query(database());
+    query.prepare("DELETE FROM tasks WHERE uuid = ?");
+    query.addBindValue(uuid);
+    if (!exec(query))
+        return false;
+
+    query.prepare("DELETE FROM task_tags WHERE task_uuid = ?");
+    query.addBindValue(uuid);
+    return exec(query);
+}
+
+bool SqliteStorage::writeTags()
+{
+    if (!exec("DELETE FROM tags"))
+        return false;
+
+    // Tags are few, they're always written together
+    QSqlQuery query(database());
+    query.prepare("INSERT INTO tags (position, uuid, name, revision, revisionOnWebDAVServer) VALUES (?, ?, ?, ?, ?)");
+    for (int i = 0; i < m_data.tags.count(); ++i) {
+        const Tag::Ptr &tag = m_data.tags.at(i);
+        query.addBindValue(i);
+        query.addBindValue(tag->uuid());
+        query.addBindValue(tag->name());
+        query.addBindValue(tag->revision());
+        query.addBindValue(tag->revisionOnWebDAVServer());
+        if (!exec(query))
+            return false;
+    }
+
+    return true;
+}
+
+bool SqliteStorage::writePositions()
+{
+    QSqlQuery query(database());
+    query.prepare("UPDATE tasks SET position = ? WHERE uuid = ?");
+    for (int i = 0; i < m_data.tasks.count(); ++i) {
+        query.addBindValue(i);
+        query.addBindValue(m_data.tasks.at(i)->uuid());
+        if (!exec(query))
+            return false;
+    }
+
+    m_firstPosition = 0;
+    m_lastPosition = m_data.tasks.count() - 1;
+    m_pendingPositions.clear();
+    m_orderChanged = false;
+    return true;
+}
+
+bool SqliteStorage::writeEverything()
+{
+    QSqlDatabase db = database();
+    db.transaction();
+    bool success = exec("DELETE FROM tasks") && exec("DELETE FROM task_tags") && writeTags();
+
+    // Positions restart at 0, writeTask() assigns them in order
+    m_firstPosition = 0;
+    m_lastPosition = -1;
+    m_pendingPositions.clear();
+    m_orderChanged = false;
+    for (int i = 0; success && i < m_data.tasks.count(); ++i)
+        success = writeTask(m_data.tasks.at(i));
+
+    QSqlQuery query(db);
+    query.prepare("INSERT OR REPLACE INTO meta (key, value) VALUES (?, ?), (?, ?)");
+    query.addBindValue("instanceId");
+    query.addBindValue(m_data.instanceId);
+    query.addBindValue("schemaVersion");
+    query.addBindValue(int(SqliteSchemaVersion1));
+    success = success && exec(query);
+
+    if (success)
+        return db.commit();
+
+    db.rollback();
+    return false;
+}
+
+void SqliteStorage::save_impl()
+{
+    if (m_fullSaveRequired) {
+        if (writeEverything())
+            clearPendingChanges();
+        return;
+    }
+
+    QSqlDatabase db = database();
+    db.transaction();
+    bool success = !m_tagsChanged || writeTags();
+
+    foreach (const QString &uuid, m_removedTaskUids) {
+        success = success && removeTaskRows(uuid);
+        m_pendingPositions.remove(uuid);
+    }
+
+    // One row-level upsert per changed task
+    foreach (const QWeakPointer<Task> &weakTask, m_changedTasks) {
+        Task::Ptr task = weakTask.toStrongRef();
+        if (task)
+            success = success && writeTask(task);
+    }
+
+    if (m_orderChanged) {
+        success = success && writePositions();
+    } else if (!m_pendingPositions.isEmpty()) { // Existing tasks moved to either end
+        QSqlQuery query(db);
+        query.prepare("UPDATE tasks SET position = ? WHERE uuid = ?");
+        QHash<QString, qint64>::const_iterator it;
+        for (it = m_pendingPositions.cbegin(); success && it != m_pendingPositions.cend(); ++it) {
+            query.addBindValue(it.value());
+            query.addBindValue(it.key());
+            success = exec(query);
+        }
+        m_pendingPositions.clear();
+    }
+
+    if (success && db.commit()) {
+        clearPendingChanges();
+    } else {
+        // Changes are kept and retried on the next save
+        qWarning() << "SqliteStorage: could not save to" << databaseFileName();
+        db.rollback();
+    }
+}
+
+QStringList SqliteStorage::uuidQuery(const QString &statement, const QVariant &value) const
+{
+    QStringList uuids;
+    QSqlQuery query(database());
+    query.prepare(statement);
+    query.addBindValue(value);
+    if (exec(query)) {
+        while (query.next())
+            uuids << query.value(0).toString();
+    }
+
+    return uuids;
+}
+
+QStringList SqliteStorage::taskUuidsForTag(const QString &tagName) const
+{
+    return uuidQuery("SELECT task_uuid FROM task_tags WHERE tag_name = ? COLLATE NOCASE", tagName);
+}
+
+QStringList SqliteStorage::taskUuidsDueUntil(const QDate &date) const
+{
+    return uuidQuery("SELECT uuid FROM tasks WHERE dueDate IS NOT NULL AND dueDate <= ? ORDER BY dueDate",
+                     date.toJulianDay());
+}
@@ -0,0 +1,77 @@
+/*
+  This file is part of Flow.
+
+  Copyright (C) 2015 Sérgio Martins <iamsergio@gmail.com>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FLOW_SQLITESTORAGE_H
+#define FLOW_SQLITESTORAGE_H
+
+#include "storage.h"
+#include "runtimeconfiguration.h"
+
+#include <QHash>
+#include <QSqlDatabase>
+
+class Kernel;
+class QSqlQuery;
+
+// Keeps tasks, tags and the task-tag relation in indexed SQLite tables.
+// Saves only touch the rows of what changed, so big archives aren't rewritten.
+// If the database doesn't exist yet the data file is imported into it.
+class SqliteStorage : public Storage
+{
+    Q_OBJECT
+public:
+    explicit SqliteStorage(Kernel *kernel, QObject *parent);
+    ~SqliteStorage();
+
+    QString databaseFileName() const;
+
+    // Answered by the indexes, doesn't depend on what's loaded
+    QStringList taskUuidsForTag(const QString &tagName) const;
+    QStringList taskUuidsDueUntil(const QDate &date) const;
+
+protected:
+    void load_impl() Q_DECL_OVERRIDE;
+    void save_impl() Q_DECL_OVERRIDE;
+
+private Q_SLOTS:
+    void onTaskRowsInserted(const QModelIndex &parent, int first, int last);
+
+private:
+    QSqlDatabase database() const;
+    bool openDatabase();
+    bool migrateFromDataFile();
+    bool migrateArchive(const QString &archiveFileName);
+    bool writeEverything();
+    bool writeTags();
+    bool writeTask(const Task::Ptr &task);
+    bool removeTaskRows(const QString &uuid);
+    bool writePositions();
+    bool exec(QSqlQuery &query) const;
+    bool exec(const QString &statement) const;
+    QStringList uuidQuery(const QString &statement, const QVariant &value) const;
+
+    const RuntimeConfiguration m_runtimeConfiguration;
+    const QString m_connectionName;
+    QHash<QString, qint64> m_pendingPositions; // For rows inserted at either end, keyed by uuid
+    qint64 m_firstPosition;
+    qint64 m_lastPosition;
+    bool m_orderChanged; // Rows were inserted in the middle, positions are rewritten
+};
+
+#endif
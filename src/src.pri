@@ -1,11 +1,13 @@
-QT += quick
+QT += quick sql
 
-SOURCES += $$PWD/checkabletagmodel.cpp \
+SOURCES += $$PWD/binaryserializer.cpp \
+           $$PWD/checkabletagmodel.cpp \
            $$PWD/circularprogressindicator.cpp \
            $$PWD/checkbox.cpp \
            $$PWD/controller.cpp  \
            $$PWD/extendedtagsmodel.cpp \
            $$PWD/jsonstorage.cpp \
+           $$PWD/jsonstreamreader.cpp \
            $$PWD/kernel.cpp \
            $$PWD/loadmanager.cpp \
            $$PWD/nonemptytagfilterproxy.cpp \
@@ -15,22 +17,28 @@ SOURCES += $$PWD/checkabletagmodel.cpp \
            $$PWD/settings.cpp    \
            $$PWD/sortedtagsmodel.cpp \
            $$PWD/sortedtaskcontextmenumodel.cpp \
+           $$PWD/sqlitestorage.cpp \
            $$PWD/storage.cpp \
+           $$PWD/storagewriter.cpp \
            $$PWD/syncable.cpp \
            $$PWD/tag.cpp \
            $$PWD/tagref.cpp \
            $$PWD/task.cpp \
+           $$PWD/taskcolumns.cpp \
            $$PWD/taskcontextmenumodel.cpp \
            $$PWD/taskfilterproxymodel.cpp \
+           $$PWD/taskstatistics.cpp \
            $$PWD/tooltipcontroller.cpp \
            $$PWD/utils.cpp
 
-HEADERS += $$PWD/checkabletagmodel.h \
+HEADERS += $$PWD/binaryserializer.h \
+           $$PWD/checkabletagmodel.h \
            $$PWD/checkbox.h \
            $$PWD/circularprogressindicator.h \
            $$PWD/controller.h      \
            $$PWD/extendedtagsmodel.h \
            $$PWD/jsonstorage.h      \
+           $$PWD/jsonstreamreader.h \
            $$PWD/kernel.h \
            $$PWD/loadmanager.h \
            $$PWD/genericlistmodel.h \
@@ -42,13 +50,18 @@ HEADERS += $$PWD/checkabletagmodel.h \
            $$PWD/settings.h        \
            $$PWD/sortedtagsmodel.h \
            $$PWD/sortedtaskcontextmenumodel.h \
+           $$PWD/sqlitestorage.h \
            $$PWD/storage.h \
+           $$PWD/storagewriter.h \
            $$PWD/syncable.h \
            $$PWD/tag.h \
            $$PWD/tagref.h \
            $$PWD/task.h \
+           $$PWD/taskcolumns.h \
            $$PWD/taskcontextmenumodel.h \
            $$PWD/taskfilterproxymodel.h \
+           $$PWD/taskstatistics.h \
+           $$PWD/taskrecord.h \
            $$PWD/tooltipcontroller.h \
            $$PWD/utils.h
 
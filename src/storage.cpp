@@ -27,6 +27,14 @@
 #include "taskfilterproxymodel.h"
 #include "runtimeconfiguration.h"
 #include "nonemptytagfilterproxy.h"
+#include "taskstatistics.h"
+
+#include <QSet>
+#include <QFile>
+#include <QJsonDocument>
+
+#include <algorithm>
+#include <functional>
 
 #if defined(UNIT_TEST_RUN)
 # include "assertingproxymodel.h"
@@ -61,6 +69,10 @@ static QVariant tasksDataFunction(const TaskList &list, int index, int role)
 Storage::Storage(Kernel *kernel, QObject *parent)
     : QObject(parent)
     , m_kernel(kernel)
+    , m_tagsChanged(false)
+    , m_fullSaveRequired(true)
+    , m_saveRequestCount(0)
+    , m_performedSaveCount(0)
     , m_savingDisabled(0)
     , m_taskFilterModel(new TaskFilterProxyModel(this))
     , m_untaggedTasksModel(new TaskFilterProxyModel(this))
@@ -71,9 +83,13 @@ Storage::Storage(Kernel *kernel, QObject *parent)
     , m_extendedTagsModel(new ExtendedTagsModel(this))
     , m_savingInProgress(false)
     , m_loadingInProgress(false)
+    , m_tagIndexDirty(true)
+    , m_rowLevelFiltering(kernel && kernel->runtimeConfiguration().rowLevelFiltering())
+    , m_statistics(new TaskStatistics(this))
+    , m_stagedFilterUpdatesBlocked(false)
+    , m_stagedFilterUpdatePending(false)
 {
     m_scheduleTimer.setSingleShot(true);
-    m_scheduleTimer.setInterval(0);
     connect(&m_scheduleTimer, &QTimer::timeout, this, &Storage::save);
 
     m_data.tags.setDataFunction(&tagsDataFunction);
@@ -84,6 +100,15 @@ Storage::Storage(Kernel *kernel, QObject *parent)
     connect(tagsModel, &QAbstractListModel::rowsInserted, this, &Storage::scheduleSave);
     connect(tagsModel, &QAbstractListModel::rowsRemoved, this, &Storage::scheduleSave);
     connect(tagsModel, &QAbstractListModel::modelReset, this, &Storage::scheduleSave);
+    connect(tagsModel, &QAbstractListModel::dataChanged, this, &Storage::onTagsChanged);
+    connect(tagsModel, &QAbstractListModel::rowsInserted, this, &Storage::onTagsChanged);
+    connect(tagsModel, &QAbstractListModel::rowsRemoved, this, &Storage::onTagsChanged);
+    connect(tagsModel, &QAbstractListModel::modelReset, this, &Storage::onTagsChanged);
+    connect(tagsModel, &QAbstractListModel::rowsInserted, this, &Storage::onTagRowsInserted);
+    connect(tagsModel, &QAbstractListModel::rowsRemoved, this, &Storage::invalidateTagIndex);
+    connect(tagsModel, &QAbstractListModel::rowsMoved, this, &Storage::invalidateTagIndex);
+    connect(tagsModel, &QAbstractListModel::layoutChanged, this, &Storage::invalidateTagIndex);
+    connect(tagsModel, &QAbstractListModel::modelReset, this, &Storage::onTagsReset);
     qRegisterMetaType<Tag::Ptr>("Tag::Ptr");
     m_sortedTagModel = new SortedTagsModel(m_data.tags, this);
     m_extendedTagsModel->setSourceModel(m_sortedTagModel);
@@ -92,15 +117,27 @@ Storage::Storage(Kernel *kernel, QObject *parent)
     connect(this, &Storage::tagAboutToBeRemoved,
             this, &Storage::onTagAboutToBeRemoved);
 
+    if (kernel)
+        connect(kernel, &Kernel::dayChanged, this, &Storage::onDayChanged);
+
+    QAbstractItemModel *tasksModel = m_data.tasks; // android doesn't build if you use m_data.tasks directly in the connect statement
+    // Connected before any proxy, so the columns are up to date when they filter
+    connect(tasksModel, &QAbstractListModel::rowsInserted, this, &Storage::onTaskRowsInserted);
+    connect(tasksModel, &QAbstractListModel::rowsAboutToBeRemoved, this, &Storage::onTaskRowsAboutToBeRemoved);
+    connect(tasksModel, &QAbstractListModel::rowsRemoved, this, &Storage::onTaskRowsRemoved);
+    connect(tasksModel, &QAbstractListModel::dataChanged, this, &Storage::onTaskDataChanged);
+    connect(tasksModel, &QAbstractListModel::modelReset, this, &Storage::onTaskRowsReset);
+
     m_taskFilterModel->setSourceModel(m_data.tasks);
     m_untaggedTasksModel->setSourceModel(m_archivedTasksModel);
     m_dueDateTasksModel->setSourceModel(m_archivedTasksModel);
 
-    QAbstractItemModel *tasksModel = m_data.tasks; // android doesn't build if you use m_data.tasks directly in the connect statement
     connect(tasksModel, &QAbstractListModel::dataChanged, this, &Storage::scheduleSave);
     connect(tasksModel, &QAbstractListModel::rowsInserted, this, &Storage::scheduleSave);
     connect(tasksModel, &QAbstractListModel::rowsRemoved, this, &Storage::scheduleSave);
     connect(tasksModel, &QAbstractListModel::modelReset, this, &Storage::scheduleSave);
+    connect(tasksModel, &QAbstractListModel::modelAboutToBeReset, this, &Storage::onTasksAboutToBeReset);
+    connect(tasksModel, &QAbstractListModel::modelReset, this, &Storage::onTasksReset);
 
     m_data.tasks.setDataFunction(&tasksDataFunction);
     m_data.tasks.insertRole("task", Q_NULLPTR, TaskRole);
@@ -116,6 +153,12 @@ Storage::Storage(Kernel *kernel, QObject *parent)
     m_dueDateTasksModel->setObjectName("Archived tasks with due date");
     m_dueDateTasksModel->sort(0, Qt::AscendingOrder);
 
+    m_taskFilterModel->setTaskColumns(&m_taskColumns);
+    m_untaggedTasksModel->setTaskColumns(&m_taskColumns);
+    m_dueDateTasksModel->setTaskColumns(&m_taskColumns);
+    m_stagedTasksModel->setTaskColumns(&m_taskColumns);
+    m_archivedTasksModel->setTaskColumns(&m_taskColumns);
+
 #if defined(UNIT_TEST_RUN)
     AssertingProxyModel *assert = new AssertingProxyModel(this);
     assert->setSourceModel(tasksModel);
@@ -143,18 +186,25 @@ Storage::Storage(Kernel *kernel, QObject *parent)
 
 Storage::~Storage()
 {
+    // Dying tasks decrement their tags' counts through the tag table, which is destroyed before
+    // m_data. The proxies are going away too, so they don't need to hear about it.
+    m_tasksByUuid.clear();
+    QAbstractItemModel *tasksModel = m_data.tasks;
+    tasksModel->blockSignals(true);
+    m_data.tasks.clear();
+
 #if defined(UNIT_TEST_RUN)
     storageCount--;
     qDebug() << "Deleted storage" << this << "; count is now" << storageCount;
 #endif
 }
 
-const TagList& Storage::tags() const
+const QList<Tag::Ptr>& Storage::tags() const
 {
     return m_data.tags;
 }
 
-TaskList Storage::tasks() const
+const QList<Task::Ptr>& Storage::tasks() const
 {
     return m_data.tasks;
 }
@@ -194,6 +244,8 @@ void Storage::load()
     m_loadingInProgress = true;
     m_savingDisabled += 1;
     load_impl();
+    clearPendingChanges(); // Nothing to save, we just loaded it
+    removeDuplicateData();
     m_savingDisabled += -1;
 
     if (m_data.tags.isEmpty()) {
@@ -210,15 +262,41 @@ void Storage::load()
     emit taskCountChanged();
 }
 
+void Storage::loadArchive()
+{
+    if (archiveLoaded())
+        return;
+
+    m_loadingInProgress = true;
+    m_savingDisabled += 1;
+    loadArchive_impl();
+    m_savingDisabled += -1;
+    m_loadingInProgress = false;
+    emit taskCountChanged();
+}
+
+bool Storage::archiveLoaded() const
+{
+    return true;
+}
+
+void Storage::loadArchive_impl()
+{
+}
+
 void Storage::save()
 {
 #if defined(UNIT_TEST_RUN)
     Storage::saveCallCount++;
 #endif
 
-    if (!m_kernel->runtimeConfiguration().saveEnabled()) // Unit-tests don't save
+    m_scheduleTimer.stop(); // In case we're called directly
+    if (!m_kernel->runtimeConfiguration().saveEnabled()) { // Unit-tests don't save
+        clearPendingChanges();
         return;
+    }
 
+    m_performedSaveCount++;
     m_savingInProgress = true;
     m_savingDisabled++;
     save_impl();
@@ -226,6 +304,56 @@ void Storage::save()
     m_savingInProgress = false;
 }
 
+void Storage::clearPendingChanges()
+{
+    m_changedTasks.clear();
+    m_removedTaskUids.clear();
+    m_tagsChanged = false;
+    m_fullSaveRequired = false;
+}
+
+void Storage::onTaskChanged()
+{
+    Task *task = qobject_cast<Task*>(sender());
+    if (task)
+        m_changedTasks.insert(task->uuidKey(), task->toStrongRef());
+
+    scheduleSave();
+}
+
+void Storage::onTagsChanged()
+{
+    m_tagsChanged = true;
+}
+
+void Storage::onTasksAboutToBeReset()
+{
+    // Tags point to the tasks being dropped
+    foreach (const QList<Tag::Ptr> &tags, m_tagsOfTask) {
+        foreach (const Tag::Ptr &tag, tags)
+            tag->clearTaggedTasks();
+    }
+    m_tagsOfTask.clear();
+    m_rowHints.clear();
+    m_tasksByDueDay.clear();
+    m_dueDayOfTask.clear();
+    m_statistics->clear();
+    m_materializedRevisions.clear();
+}
+
+void Storage::onTasksReset()
+{
+    m_tasksByUuid.clear();
+    foreach (const Task::Ptr &task, m_data.tasks)
+        connectTask(task);
+    indexTasks(m_data.tasks);
+
+    // We don't know what changed, nothing incremental to do
+    m_changedTasks.clear();
+    m_removedTaskUids.clear();
+    m_fullSaveRequired = true;
+}
+
 int Storage::serializerVersion() const
 {
     return JsonSerializerVersion1;
@@ -238,9 +366,27 @@ bool Storage::saveScheduled() const
 
 void Storage::scheduleSave()
 {
-    if (m_savingDisabled == 0) {
-        m_scheduleTimer.start();
-    }
+    if (m_savingDisabled != 0)
+        return;
+
+    m_saveRequestCount++;
+    if (!m_scheduleTimer.isActive())
+        m_oldestUnsavedChange.start();
+
+    // Every request restarts the quiet period, up to the staleness bound of the oldest change
+    const RuntimeConfiguration &config = m_kernel->runtimeConfiguration();
+    const qint64 remaining = config.saveMaxStaleness() - m_oldestUnsavedChange.elapsed();
+    m_scheduleTimer.start(int(qBound<qint64>(0, remaining, config.saveQuietPeriod())));
+}
+
+int Storage::saveRequestCount() const
+{
+    return m_saveRequestCount;
+}
+
+int Storage::performedSaveCount() const
+{
+    return m_performedSaveCount;
 }
 
 bool Storage::removeTag(const QString &tagName)
@@ -284,19 +430,69 @@ Tag::Ptr Storage::createTag(const QString &tagName, const QString &uid)
     if (!uid.isEmpty())
         tag->setUuid(uid);
 
+    connect(tag.data(), &Tag::nameChanged, this, &Storage::onTagsChanged);
     m_data.tags << tag;
     return tag;
 }
 
 int Storage::indexOfTag(const QString &name) const
 {
-    QString normalizedName = name.toLower().trimmed();
+    if (m_tagIndexDirty)
+        rebuildTagIndex();
+
+    return m_tagIndexByName.value(name.toLower().trimmed(), -1);
+}
+
+void Storage::rebuildTagIndex() const
+{
+    m_tagIndexByName.clear();
+    m_tagIndexByName.reserve(m_data.tags.count());
     for (int i = 0; i < m_data.tags.count(); ++i) {
-        if (m_data.tags.at(i)->name().toLower() == normalizedName)
-            return i;
+        const QString normalizedName = m_data.tags.at(i)->name().toLower();
+        if (!m_tagIndexByName.contains(normalizedName)) // First one wins if there are duplicates
+            m_tagIndexByName.insert(normalizedName, i);
+    }
+
+    m_tagIndexDirty = false;
+}
+
+void Storage::onTagRowsInserted(const QModelIndex &, int first, int last)
+{
+    for (int i = first; i <= last; ++i) {
+        connect(m_data.tags.at(i).data(), &Tag::nameChanged,
+                this, &Storage::invalidateTagIndex, Qt::UniqueConnection);
+    }
+
+    if (m_tagIndexDirty)
+        return;
+
+    if (last != m_data.tags.count() - 1) {
+        // Inserted in the middle, the rows after it shifted
+        m_tagIndexDirty = true;
+        return;
+    }
+
+    // Appending, which is what createTag() does, keeps the index valid
+    for (int i = first; i <= last; ++i) {
+        const QString normalizedName = m_data.tags.at(i)->name().toLower();
+        if (!m_tagIndexByName.contains(normalizedName))
+            m_tagIndexByName.insert(normalizedName, i);
+    }
+}
+
+void Storage::onTagsReset()
+{
+    foreach (const Tag::Ptr &tag, m_data.tags) {
+        connect(tag.data(), &Tag::nameChanged,
+                this, &Storage::invalidateTagIndex, Qt::UniqueConnection);
     }
 
-    return -1;
+    m_tagIndexDirty = true;
+}
+
+void Storage::invalidateTagIndex()
+{
+    m_tagIndexDirty = true;
 }
 
 QString Storage::dataFile() const
@@ -316,13 +512,7 @@ QString Storage::deletedTagName() const
 
 bool Storage::containsTag(const QString &name) const
 {
-    QString normalizedName = name.toLower().trimmed();
-    foreach (const Tag::Ptr &tag, m_data.tags) {
-        if (tag->name().toLower() == normalizedName)
-            return true;
-    }
-
-    return false;
+    return indexOfTag(name) != -1;
 }
 
 void Storage::clearTags()
@@ -355,10 +545,9 @@ bool Storage::renameTag(const QString &oldName, const QString &newName)
     if (!createTag(trimmedNewName, oldTag->uuid()))
         return false;
 
-    foreach (const Task::Ptr &task, m_data.tasks) {
-        if (task->containsTag(oldName))
-            task->addTag(trimmedNewName);
-    }
+    foreach (Task *task, oldTag->taggedTasks())
+        task->addTag(trimmedNewName);
+    renameDormantTag(oldTag->name(), trimmedNewName);
 
     if (!removeTag(oldName))
         return false;
@@ -369,8 +558,13 @@ bool Storage::renameTag(const QString &oldName, const QString &newName)
 
 void Storage::onTagAboutToBeRemoved(const QString &tagName)
 {
-    foreach (const Task::Ptr &task, m_data.tasks)
+    Tag::Ptr tag = this->tag(tagName, /*create=*/ false);
+    if (!tag)
+        return;
+
+    foreach (Task *task, tag->taggedTasks())
         task->removeTag(tagName);
+    renameDormantTag(tag->name(), QString());
 }
 
 TaskFilterProxyModel *Storage::taskFilterModel() const
@@ -399,6 +593,11 @@ TaskFilterProxyModel *Storage::archivedTasksModel() const
     return m_archivedTasksModel;
 }
 
+const TaskColumns &Storage::taskColumns() const
+{
+    return m_taskColumns;
+}
+
 void Storage::dumpDebugInfo()
 {
     qDebug() << Q_FUNC_INFO;
@@ -423,12 +622,10 @@ int Storage::proxyRowToSource(int proxyRow) const
 
 int Storage::indexOfTask(const Task::Ptr &task) const
 {
-    for (int i = 0; i < m_data.tasks.count(); ++i) {
-        if (m_data.tasks.at(i) == task)
-            return i;
-    }
+    if (!task || m_tasksByUuid.value(task->uuidKey()) != task)
+        return -1;
 
-    return -1;
+    return rowOfTask(task.data());
 }
 
 void Storage::clearTasks()
@@ -474,6 +671,447 @@ QByteArray Storage::instanceId()
     return m_data.instanceId;
 }
 
+Task::Ptr Storage::taskForUuid(const QString &uuid) const
+{
+    return m_tasksByUuid.value(Syncable::keyForUuid(uuid));
+}
+
+int Storage::dormantTaskCount() const
+{
+    return m_dormantTasks.count();
+}
+
+const QVector<TaskRecord> &Storage::dormantTasks() const
+{
+    return m_dormantTasks;
+}
+
+void Storage::addDormantTagCount(const QString &tagName, int count)
+{
+    Tag::Ptr tag = this->tag(tagName, /*create=*/ false);
+    if (!tag || count == 0)
+        return;
+
+    tag->incrementTaskCount(count);
+    const QString key = tag->name().toLower();
+    const int total = m_dormantTagCounts.value(key) + count;
+    if (total == 0)
+        m_dormantTagCounts.remove(key);
+    else
+        m_dormantTagCounts.insert(key, total);
+}
+
+void Storage::addDormantTasks(const QVector<TaskRecord> &records)
+{
+    m_dormantTasks.reserve(m_dormantTasks.count() + records.count());
+    foreach (TaskRecord record, records) {
+        const QUuid key = Syncable::keyForUuid(record.uuid);
+        if (!key.isNull() && (m_tasksByUuid.contains(key) || m_dormantTaskIndexByUuid.contains(key)))
+            continue; // Already have it
+
+        // Records don't create tags, they only reference existing ones
+        QStringList tagNames;
+        foreach (const QString &tagName, record.tags) {
+            Tag::Ptr tag = this->tag(tagName, /*create=*/ false);
+            if (tag && !tagNames.contains(tag->name())) {
+                tagNames << tag->name();
+                addDormantTagCount(tag->name(), 1);
+            }
+        }
+        record.tags = tagNames;
+
+        if (!key.isNull())
+            m_dormantTaskIndexByUuid.insert(key, m_dormantTasks.count());
+        m_dormantTasks << record;
+    }
+}
+
+TaskRecord Storage::takeDormantTask(int index)
+{
+    const TaskRecord record = m_dormantTasks.at(index);
+    m_dormantTaskIndexByUuid.remove(Syncable::keyForUuid(record.uuid));
+
+    const int last = m_dormantTasks.count() - 1;
+    if (index != last) {
+        m_dormantTasks[index] = m_dormantTasks.at(last);
+        if (!m_dormantTasks.at(index).uuid.isEmpty())
+            m_dormantTaskIndexByUuid.insert(Syncable::keyForUuid(m_dormantTasks.at(index).uuid), index);
+    }
+    m_dormantTasks.removeLast();
+
+    return record;
+}
+
+void Storage::materializeDormantTasks(QList<int> indexes)
+{
+    if (indexes.isEmpty())
+        return;
+
+    // Highest first, so swapping with the last record doesn't move one we still want
+    std::sort(indexes.begin(), indexes.end(), std::greater<int>());
+
+    QList<Task::Ptr> tasks;
+    foreach (int index, indexes) {
+        const TaskRecord record = takeDormantTask(index);
+        foreach (const QString &tagName, record.tags)
+            addDormantTagCount(tagName, -1); // The Task counts itself now
+
+        Task::Ptr task = Task::createTask(m_kernel);
+        task->fromRecord(record);
+        m_materializedRevisions.insert(task.data(), task->revision());
+        tasks.prepend(task);
+    }
+
+    const bool wasLoading = m_loadingInProgress;
+    m_loadingInProgress = true; // They're not changes
+    m_savingDisabled++;
+    addTasks(tasks);
+    m_savingDisabled--;
+    m_loadingInProgress = wasLoading;
+}
+
+void Storage::materializeTasksWithTag(const QString &tagName)
+{
+    const QString name = tagName.trimmed();
+    QList<int> indexes;
+    for (int i = 0; i < m_dormantTasks.count(); ++i) {
+        const QStringList &tags = m_dormantTasks.at(i).tags;
+        if (name.isEmpty() ? tags.isEmpty() : tags.contains(name, Qt::CaseInsensitive))
+            indexes << i;
+    }
+
+    materializeDormantTasks(indexes);
+}
+
+void Storage::materializeAllTasks()
+{
+    QList<int> indexes;
+    indexes.reserve(m_dormantTasks.count());
+    for (int i = 0; i < m_dormantTasks.count(); ++i)
+        indexes << i;
+
+    materializeDormantTasks(indexes);
+}
+
+Task::Ptr Storage::materializeTask(const QString &uuid)
+{
+    const int index = m_dormantTaskIndexByUuid.value(Syncable::keyForUuid(uuid), -1);
+    if (index != -1)
+        materializeDormantTasks(QList<int>() << index);
+
+    return taskForUuid(uuid);
+}
+
+int Storage::recycleMaterializedTasks(const QList<Task*> &inUse)
+{
+    QList<Task::Ptr> tasks;
+    QHash<Task*, int>::const_iterator it;
+    for (it = m_materializedRevisions.cbegin(); it != m_materializedRevisions.cend(); ++it) {
+        Task *task = it.key();
+        if (task->revision() != it.value() || task->staged() || task->status() != TaskStopped
+            || task->hasMenuModels() || inUse.contains(task))
+            continue;
+        tasks << task->toStrongRef();
+    }
+
+    if (tasks.isEmpty())
+        return 0;
+
+    QVector<TaskRecord> records;
+    records.reserve(tasks.count());
+    m_savingDisabled++;
+    foreach (const Task::Ptr &task, tasks) {
+        records << task->toRecord();
+        disconnect(task.data(), Q_NULLPTR, this, Q_NULLPTR);
+        m_data.tasks.removeAll(task);
+        unindexTask(task);
+        task->setTagList(TagRef::List()); // The record counts for the tags now
+    }
+    m_savingDisabled--;
+
+    addDormantTasks(records);
+    emit taskCountChanged();
+    return tasks.count();
+}
+
+void Storage::renameDormantTag(const QString &oldName, const QString &newName)
+{
+    const int count = m_dormantTagCounts.value(oldName.toLower());
+    if (count == 0)
+        return;
+
+    // An empty newName means the tag is being removed
+    for (int i = 0; i < m_dormantTasks.count(); ++i) {
+        QStringList &tags = m_dormantTasks[i].tags;
+        for (int j = tags.count() - 1; j >= 0; --j) {
+            if (tags.at(j).compare(oldName, Qt::CaseInsensitive) != 0)
+                continue;
+            if (newName.isEmpty())
+                tags.removeAt(j);
+            else
+                tags[j] = newName;
+        }
+    }
+
+    addDormantTagCount(oldName, -count);
+    if (!newName.isEmpty())
+        addDormantTagCount(newName, count);
+}
+
+int Storage::internTag(const Tag::Ptr &tag)
+{
+    Q_ASSERT(tag);
+    if (tag->m_internId != -1 && tagForId(tag->m_internId) == tag)
+        return tag->m_internId;
+
+    tag->m_internId = m_tagTable.count();
+    m_tagTable.append(tag.toWeakRef());
+    return tag->m_internId;
+}
+
+Tag::Ptr Storage::tagForId(int id) const
+{
+    if (id < 0 || id >= m_tagTable.count())
+        return Tag::Ptr();
+
+    return m_tagTable.at(id).toStrongRef();
+}
+
+static QList<Tag::Ptr> tagsOfTask(const Task *task)
+{
+    QList<Tag::Ptr> tags;
+    const QList<TagRef> &tagRefs = task->tags();
+    for (int i = 0; i < tagRefs.count(); ++i) {
+        Tag::Ptr tag = tagRefs.at(i).tag();
+        if (tag && !tags.contains(tag))
+            tags << tag;
+    }
+
+    return tags;
+}
+
+void Storage::indexTasks(const QList<Task::Ptr> &tasks)
+{
+    QHash<Tag*, QList<Task*> > tasksByTag; // So each tag gets a single insertion
+    QList<Task*> newTasks;
+    foreach (const Task::Ptr &task, tasks) {
+        const QUuid key = task->uuidKey();
+        if (!m_tasksByUuid.contains(key)) // If duplicated, the first one wins
+            m_tasksByUuid.insert(key, task);
+
+        if (m_tagsOfTask.contains(task.data()))
+            continue;
+
+        const QList<Tag::Ptr> tags = tagsOfTask(task.data());
+        m_tagsOfTask.insert(task.data(), tags);
+        indexDueDate(task.data());
+        newTasks << task.data();
+        foreach (const Tag::Ptr &tag, tags)
+            tasksByTag[tag.data()] << task.data();
+    }
+
+    QHash<Tag*, QList<Task*> >::const_iterator it;
+    for (it = tasksByTag.cbegin(); it != tasksByTag.cend(); ++it)
+        it.key()->addTaggedTasks(it.value());
+
+    m_statistics->addTasks(newTasks);
+}
+
+void Storage::unindexTask(const Task::Ptr &task)
+{
+    if (m_tasksByUuid.value(task->uuidKey()) == task)
+        m_tasksByUuid.remove(task->uuidKey());
+
+    foreach (const Tag::Ptr &tag, m_tagsOfTask.take(task.data()))
+        tag->removeTaggedTask(task.data());
+    m_rowHints.remove(task.data());
+    unindexDueDate(task.data());
+    m_statistics->removeTask(task.data());
+    m_materializedRevisions.remove(task.data());
+}
+
+void Storage::indexDueDate(Task *task)
+{
+    const QDate dueDate = task->dueDate();
+    if (!dueDate.isValid())
+        return;
+
+    m_dueDayOfTask.insert(task, dueDate.toJulianDay());
+    m_tasksByDueDay[dueDate.toJulianDay()] << task;
+}
+
+void Storage::unindexDueDate(Task *task)
+{
+    QHash<Task*, qint64>::iterator it = m_dueDayOfTask.find(task);
+    if (it == m_dueDayOfTask.end())
+        return;
+
+    QMap<qint64, QList<Task*> >::iterator bucket = m_tasksByDueDay.find(it.value());
+    if (bucket != m_tasksByDueDay.end()) {
+        bucket.value().removeOne(task);
+        if (bucket.value().isEmpty())
+            m_tasksByDueDay.erase(bucket);
+    }
+    m_dueDayOfTask.erase(it);
+}
+
+void Storage::onTaskDueDateChanged()
+{
+    Task *task = qobject_cast<Task*>(sender());
+    if (!task || !m_tagsOfTask.contains(task)) // Not stored
+        return;
+
+    unindexDueDate(task);
+    indexDueDate(task);
+    m_statistics->updateTask(task);
+}
+
+void Storage::onTaskColumnDataChanged()
+{
+    Task *task = qobject_cast<Task*>(sender());
+    if (!task)
+        return;
+
+    const int row = rowOfTask(task);
+    if (row != -1)
+        m_taskColumns.updateRows(m_data.tasks, row, row);
+}
+
+void Storage::onTaskRowsInserted(const QModelIndex &, int first, int last)
+{
+    m_taskColumns.insertRows(m_data.tasks, first, last);
+    updateRowHints(first, m_data.tasks.count() - 1); // Appending only touches the new rows
+}
+
+void Storage::onTaskRowsAboutToBeRemoved(const QModelIndex &, int first, int last)
+{
+    // They stay indexed until removeTask() is done with them, but have no row anymore
+    for (int i = first; i <= last; ++i)
+        m_rowHints.remove(m_data.tasks.at(i).data());
+}
+
+void Storage::onTaskRowsRemoved(const QModelIndex &, int first, int last)
+{
+    m_taskColumns.removeRows(first, last);
+    updateRowHints(first, m_data.tasks.count() - 1);
+}
+
+void Storage::onTaskDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight)
+{
+    m_taskColumns.updateRows(m_data.tasks, topLeft.row(), bottomRight.row());
+    updateRowHints(topLeft.row(), bottomRight.row()); // replace() and swap() don't move the others
+}
+
+void Storage::onTaskRowsReset()
+{
+    m_taskColumns.reset(m_data.tasks);
+    m_rowHints.reserve(m_data.tasks.count());
+    updateRowHints(0, m_data.tasks.count() - 1);
+}
+
+void Storage::updateRowHints(int first, int last)
+{
+    for (int i = first; i <= last; ++i)
+        m_rowHints.insert(m_data.tasks.at(i).data(), i);
+}
+
+void Storage::onTaskStagedChanged()
+{
+    if (m_stagedFilterUpdatesBlocked) {
+        m_stagedFilterUpdatePending = true;
+        return;
+    }
+
+    m_stagedTasksModel->invalidateFilter();
+    m_archivedTasksModel->invalidateFilter();
+}
+
+void Storage::onDayChanged()
+{
+    // Tasks due later than a week from now can't change their due status or pretty due date
+    // string. Every overdue task is visited, since one might have been unstaged meanwhile.
+    const qint64 today = QDate::currentDate().toJulianDay();
+    QMap<qint64, QList<Task*> >::const_iterator it = m_tasksByDueDay.constBegin();
+    const QMap<qint64, QList<Task*> >::const_iterator end = m_tasksByDueDay.upperBound(today + 7);
+    m_statistics->setToday(today);
+
+    QList<Task*> tasks;
+    for (; it != end; ++it)
+        tasks += it.value();
+
+    if (tasks.isEmpty())
+        return;
+
+    // Stage everything that became due in one go, with a single filter update
+    m_stagedFilterUpdatesBlocked = true;
+    foreach (Task *task, tasks)
+        task->onDayChanged();
+    m_stagedFilterUpdatesBlocked = false;
+
+    if (m_stagedFilterUpdatePending) {
+        m_stagedFilterUpdatePending = false;
+        m_stagedTasksModel->invalidateFilter();
+        m_archivedTasksModel->invalidateFilter();
+    }
+}
+
+void Storage::onTaskTagsChanged()
+{
+    Task *task = qobject_cast<Task*>(sender());
+    if (!task || !m_tagsOfTask.contains(task)) // Not stored
+        return;
+
+    const QList<Tag::Ptr> newTags = tagsOfTask(task);
+    QList<Tag::Ptr> &oldTags = m_tagsOfTask[task];
+    foreach (const Tag::Ptr &tag, oldTags) {
+        if (!newTags.contains(tag))
+            tag->removeTaggedTask(task);
+    }
+
+    foreach (const Tag::Ptr &tag, newTags) {
+        if (!oldTags.contains(tag))
+            tag->addTaggedTasks(QList<Task*>() << task);
+    }
+
+    oldTags = newTags;
+}
+
+void Storage::onTaskRowChanged()
+{
+    Task *task = qobject_cast<Task*>(sender());
+    if (!task)
+        return;
+
+    const int row = rowOfTask(task);
+    if (row == -1)
+        return;
+
+    // The proxies have dynamicSortFilter, so dataChanged makes them filter and sort only this row.
+    // It's not a change to save, the task itself already said so if it was.
+    m_savingDisabled++;
+    m_data.tasks.replace(row, m_data.tasks.at(row));
+    m_savingDisabled--;
+}
+
+void Storage::onTaskFilterDataChanged()
+{
+    Task *task = qobject_cast<Task*>(sender());
+    foreach (const Tag::Ptr &tag, m_tagsOfTask.value(task))
+        tag->taggedTaskChanged(task);
+    m_statistics->updateTask(task);
+}
+
+int Storage::rowOfTask(Task *task) const
+{
+    if (!m_tagsOfTask.contains(task)) // Not stored
+        return -1;
+
+    // No hint means it's being removed, a wrong one is a bug in the row bookkeeping
+    const int row = m_rowHints.value(task, -1);
+    Q_ASSERT(row == -1 || (row < m_data.tasks.count() && m_data.tasks.at(row).data() == task));
+    return row;
+}
+
 Task::Ptr Storage::taskAt(int index) const
 {
     return m_data.tasks.value(index);
@@ -490,14 +1128,38 @@ Task::Ptr Storage::prependTask(const QString &taskText)
     Task::Ptr task = Task::createTask(m_kernel, taskText);
     connectTask(task);
     m_data.tasks.prepend(task);
+    indexTasks(QList<Task::Ptr>() << task);
+    m_changedTasks.insert(task->uuidKey(), task);
     emit taskCountChanged();
     return task;
 }
 
-Task::Ptr Storage::addTask(const Task::Ptr &task)
+void Storage::addTasks(const QList<Task::Ptr> &tasks)
+{
+    if (tasks.isEmpty())
+        return;
+
+    foreach (const Task::Ptr &task, tasks) {
+        connectTask(task);
+        if (!m_loadingInProgress)
+            m_changedTasks.insert(task->uuidKey(), task);
+    }
+
+    m_data.tasks << tasks; // Proxies get one rowsInserted for the whole range
+    indexTasks(tasks);
+    emit taskCountChanged();
+}
+
+Task::Ptr Storage::addTask(const Task::Ptr &task, int row)
 {
     connectTask(task);
-    m_data.tasks << task;
+    if (row >= 0 && row < m_data.tasks.count())
+        m_data.tasks.insert(row, task);
+    else
+        m_data.tasks << task;
+    indexTasks(QList<Task::Ptr>() << task);
+    if (!m_loadingInProgress)
+        m_changedTasks.insert(task->uuidKey(), task);
     emit taskCountChanged();
     return task;
 }
@@ -505,77 +1167,209 @@ Task::Ptr Storage::addTask(const Task::Ptr &task)
 void Storage::connectTask(const Task::Ptr &task)
 {
     connect(task.data(), &Task::changed, this,
-            &Storage::scheduleSave, Qt::UniqueConnection);
-    connect(task.data(), &Task::stagedChanged, m_stagedTasksModel,
-            &TaskFilterProxyModel::invalidateFilter, Qt::UniqueConnection);
-    connect(task.data(), &Task::stagedChanged, m_archivedTasksModel,
-            &TaskFilterProxyModel::invalidateFilter, Qt::UniqueConnection);
-    connect(task.data(), &Task::tagsChanged, m_untaggedTasksModel,
-            &TaskFilterProxyModel::invalidateFilter, Qt::UniqueConnection);
-    connect(task.data(), &Task::dueDateChanged, m_dueDateTasksModel,
-            &TaskFilterProxyModel::invalidate, Qt::UniqueConnection); // invalidate sorting too
-    connect(task.data(), &Task::statusChanged, m_stagedTasksModel,
-            &TaskFilterProxyModel::invalidateFilter, Qt::UniqueConnection);
-
-    connect(task.data(), &Task::priorityChanged, m_stagedTasksModel,
-            &TaskFilterProxyModel::invalidate, Qt::UniqueConnection);
-    connect(task.data(), &Task::priorityChanged, m_archivedTasksModel,
-            &TaskFilterProxyModel::invalidate, Qt::UniqueConnection);
+            &Storage::onTaskChanged, Qt::UniqueConnection);
+
+    if (m_rowLevelFiltering) {
+        // Proxies re-evaluate just this task's row, see onTaskRowChanged()
+        connect(task.data(), &Task::stagedChanged, this,
+                &Storage::onTaskRowChanged, Qt::UniqueConnection);
+        connect(task.data(), &Task::statusChanged, this,
+                &Storage::onTaskRowChanged, Qt::UniqueConnection);
+        connect(task.data(), &Task::tagsChanged, this,
+                &Storage::onTaskRowChanged, Qt::UniqueConnection);
+        connect(task.data(), &Task::dueDateChanged, this,
+                &Storage::onTaskRowChanged, Qt::UniqueConnection);
+        connect(task.data(), &Task::priorityChanged, this,
+                &Storage::onTaskRowChanged, Qt::UniqueConnection);
+    } else {
+        // Before the proxies are invalidated, they read the columns
+        connect(task.data(), &Task::stagedChanged, this,
+                &Storage::onTaskColumnDataChanged, Qt::UniqueConnection);
+        connect(task.data(), &Task::statusChanged, this,
+                &Storage::onTaskColumnDataChanged, Qt::UniqueConnection);
+        connect(task.data(), &Task::tagsChanged, this,
+                &Storage::onTaskColumnDataChanged, Qt::UniqueConnection);
+        connect(task.data(), &Task::dueDateChanged, this,
+                &Storage::onTaskColumnDataChanged, Qt::UniqueConnection);
+        connect(task.data(), &Task::priorityChanged, this,
+                &Storage::onTaskColumnDataChanged, Qt::UniqueConnection);
+
+        connect(task.data(), &Task::stagedChanged, this,
+                &Storage::onTaskStagedChanged, Qt::UniqueConnection);
+        connect(task.data(), &Task::tagsChanged, m_untaggedTasksModel,
+                &TaskFilterProxyModel::invalidateFilter, Qt::UniqueConnection);
+        connect(task.data(), &Task::dueDateChanged, m_dueDateTasksModel,
+                &TaskFilterProxyModel::invalidate, Qt::UniqueConnection); // invalidate sorting too
+        connect(task.data(), &Task::statusChanged, m_stagedTasksModel,
+                &TaskFilterProxyModel::invalidateFilter, Qt::UniqueConnection);
+
+        connect(task.data(), &Task::priorityChanged, m_stagedTasksModel,
+                &TaskFilterProxyModel::invalidate, Qt::UniqueConnection);
+        connect(task.data(), &Task::priorityChanged, m_archivedTasksModel,
+                &TaskFilterProxyModel::invalidate, Qt::UniqueConnection);
+    }
+
+    // Keeps the tag -> tasks index and the per-tag models up to date
+    connect(task.data(), &Task::tagsChanged, this,
+            &Storage::onTaskTagsChanged, Qt::UniqueConnection);
+    connect(task.data(), &Task::stagedChanged, this,
+            &Storage::onTaskFilterDataChanged, Qt::UniqueConnection);
+    connect(task.data(), &Task::statusChanged, this,
+            &Storage::onTaskFilterDataChanged, Qt::UniqueConnection);
+    connect(task.data(), &Task::priorityChanged, this,
+            &Storage::onTaskFilterDataChanged, Qt::UniqueConnection);
+    connect(task.data(), &Task::dueDateChanged, this,
+            &Storage::onTaskDueDateChanged, Qt::UniqueConnection);
+}
+
+void Storage::replaceTask(const Task::Ptr &oldTask, const Task::Ptr &newTask)
+{
+    // Task::fromRecord() doesn't emit, so the indexes and proxies wouldn't follow an update in place
+    const int row = rowOfTask(oldTask.data());
+    Q_ASSERT(row != -1);
+    if (row == -1)
+        return;
+
+    unindexTask(oldTask);
+    oldTask->disconnect(this);
+    oldTask->setTagList(TagRef::List());
+
+    connectTask(newTask);
+    indexTasks(QList<Task::Ptr>() << newTask);
+    m_data.tasks.replace(row, newTask); // Updates the columns, the row hint and refilters the row
+    if (!m_loadingInProgress)
+        m_changedTasks.insert(newTask->uuidKey(), newTask);
 }
 
 void Storage::removeTask(const Task::Ptr &task)
 {
-    m_data.tasks.removeAll(task);
+    const bool wasStored = m_data.tasks.removeAll(task) > 0;
+    if (wasStored)
+        unindexTask(task);
     task->setTagList(TagRef::List()); // So Tag::taskCount() decreases in case Task::Ptr is left hanging somewhere
+    if (wasStored) {
+        m_changedTasks.remove(task->uuidKey());
+        m_removedTaskUids << task->uuid();
+    }
+
     if (webDAVSyncSupported())
         m_data.deletedItemUids << task->uuid(); // TODO: Make this persistent
     emit taskCountChanged();
 }
 
-#ifdef DEVELOPER_MODE
-void Storage::removeDuplicateData()
+int Storage::replayJournalFile(const QString &fileName)
 {
-    Data newData;
-    foreach (const Task::Ptr &task, m_data.tasks) {
-        bool found = false;
-        foreach (const Task::Ptr &task2, newData.tasks) {
-            if (task->uuid() != task2->uuid())
-                continue;
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Could not open journal" << fileName
+                   << "; error=" << file.errorString() << file.error();
+        return 0;
+    }
 
-            found = true;
-            break;
+    int numRecords = 0;
+    while (!file.atEnd()) {
+        const QByteArray line = file.readLine();
+        QJsonParseError jsonError;
+        const QVariantMap record = QJsonDocument::fromJson(line, &jsonError).toVariant().toMap();
+        if (jsonError.error != QJsonParseError::NoError) {
+            // A crash while appending leaves a truncated line behind, the other records are still good
+            qWarning() << "Ignoring invalid journal record:" << jsonError.errorString();
+            continue;
         }
 
-        if (found) {
-            qDebug() << "Task " << task->summary() << task->uuid() << "is a duplicate";
+        const QString op = record.value("op").toString();
+        if (op == "task") {
+            const QVariantMap taskMap = record.value("task").toMap();
+            const QString uuid = taskMap.value("uuid").toString();
+            Task::Ptr task = taskForUuid(uuid);
+            if (task) {
+                // Records older than what the snapshot has were already compacted
+                if (taskMap.value("revision").toInt() >= task->revision()) {
+                    Task::Ptr newTask = Task::createTask(m_kernel);
+                    newTask->fromJson(taskMap);
+                    replaceTask(task, newTask);
+                }
+            } else {
+                task = Task::createTask(m_kernel);
+                task->fromJson(taskMap);
+                addTask(task, record.value("row", -1).toInt()); // Older journals have no row
+            }
+        } else if (op == "removeTask") {
+            Task::Ptr task = taskForUuid(record.value("uuid").toString());
+            if (task)
+                removeTask(task);
+        } else if (op == "tags") {
+            QStringList names;
+            foreach (const QVariant &t, record.value("tags").toList()) {
+                const QVariantMap tagMap = t.toMap();
+                const QString name = tagMap.value("name").toString();
+                Tag::Ptr tag = this->tag(name, /*create=*/ false);
+                if (!tag) {
+                    tag = createTag(name, tagMap.value("uuid").toString());
+                    if (tag)
+                        tag->fromJson(tagMap);
+                }
+
+                if (tag)
+                    names << tag->name().toLower();
+            }
+
+            foreach (const Tag::Ptr &tag, m_data.tags) {
+                if (!names.contains(tag->name().toLower()))
+                    removeTag(tag->name());
+            }
         } else {
-            newData.tasks << task;
+            qWarning() << "Unknown journal record" << op;
+            continue;
         }
+
+        ++numRecords;
     }
 
-    foreach (const Tag::Ptr &tag, m_data.tags) {
-        bool found = false;
-        foreach (const Tag::Ptr &tag2, newData.tags) {
-            if (tag->name() != tag2->name())
-                continue;
+    qDebug() << "Storage: Replayed" << numRecords << "journal records from" << fileName;
+    return numRecords;
+}
 
-            found = true;
-            break;
+int Storage::removeDuplicateData()
+{
+    QSet<QUuid> seenUuids;
+    seenUuids.reserve(m_data.tasks.count());
+    QList<Task::Ptr> uniqueTasks;
+    uniqueTasks.reserve(m_data.tasks.count());
+    foreach (const Task::Ptr &task, m_data.tasks) {
+        if (seenUuids.contains(task->uuidKey())) {
+            qDebug() << "Task " << task->summary() << task->uuid() << "is a duplicate";
+        } else {
+            seenUuids.insert(task->uuidKey());
+            uniqueTasks << task;
         }
+    }
 
-        if (found) {
+    QSet<QString> seenNames;
+    QList<Tag::Ptr> uniqueTags;
+    foreach (const Tag::Ptr &tag, m_data.tags) {
+        const QString normalizedName = tag->name().toLower();
+        if (seenNames.contains(normalizedName)) {
             qDebug() << "Tag " << tag->name() << "is a duplicate";
         } else {
-            newData.tags << tag;
+            seenNames.insert(normalizedName);
+            uniqueTags << tag;
         }
     }
 
+    const int numDuplicates = m_data.tasks.count() - uniqueTasks.count()
+                              + m_data.tags.count() - uniqueTags.count();
+    if (numDuplicates == 0)
+        return 0; // The usual case, don't reset the models
+
+    Data newData;
+    newData.tasks << uniqueTasks;
+    newData.tags << uniqueTags;
+    newData.deletedItemUids = m_data.deletedItemUids;
     setData(newData);
-    qDebug() << Q_FUNC_INFO << "done";
+    return numDuplicates;
 }
 
-#endif
-
 QAbstractItemModel* Storage::nonEmptyTagsModel() const
 {
     return m_nonEmptyTagsModel;
@@ -588,15 +1382,12 @@ int Storage::taskCount() const
 
 int Storage::ageAverage() const
 {
-    if (m_data.tasks.isEmpty())
-        return 0;
-
-    int totalAge = 0;
-    foreach (const Task::Ptr &task, m_data.tasks) {
-        totalAge += task->daysSinceCreation();
-    }
+    return m_statistics->ageAverage();
+}
 
-    return totalAge / m_data.tasks.count();
+TaskStatistics *Storage::statistics() const
+{
+    return m_statistics;
 }
 
 ExtendedTagsModel* Storage::extendedTagsModel() const
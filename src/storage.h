@@ -22,17 +22,25 @@
 
 #include "task.h"
 #include "tag.h"
+#include "taskrecord.h"
+#include "taskcolumns.h"
 #include "genericlistmodel.h"
 
 #include <QTimer>
+#include <QElapsedTimer>
 #include <QObject>
 #include <QUuid>
+#include <QHash>
+#include <QWeakPointer>
+#include <QVector>
+#include <QMap>
 
 class Kernel;
 class SortedTagsModel;
 class TaskFilterProxyModel;
 class NonEmptyTagFilterProxy;
 class ExtendedTagsModel;
+class TaskStatistics;
 
 typedef GenericListModel<Tag::Ptr> TagList;
 typedef GenericListModel<Task::Ptr> TaskList;
@@ -46,6 +54,7 @@ class Storage : public QObject
     Q_OBJECT
     Q_PROPERTY(ExtendedTagsModel* extendedTagsModel READ extendedTagsModel CONSTANT)
     Q_PROPERTY(int ageAverage READ ageAverage NOTIFY taskCountChanged)
+    Q_PROPERTY(TaskStatistics* statistics READ statistics CONSTANT)
     Q_PROPERTY(int taskCount READ taskCount NOTIFY taskCountChanged)
     Q_PROPERTY(QAbstractItemModel* nonEmptyTagsModel READ nonEmptyTagsModel CONSTANT)
     Q_PROPERTY(QAbstractItemModel* tagsModel READ tagsModel CONSTANT)
@@ -80,8 +89,9 @@ public:
     explicit Storage(Kernel *kernel, QObject *parent = 0);
     ~Storage();
 
-    const TagList& tags() const;
-    TaskList tasks() const;
+    // Read-only views, they don't copy the models
+    const QList<Tag::Ptr>& tags() const;
+    const QList<Task::Ptr>& tasks() const;
     Storage::Data data() const;
     void setData(Data &data);
 
@@ -89,27 +99,34 @@ public:
 
     bool saveScheduled() const;
     void scheduleSave();
+    // How many times a save was requested vs how many were actually done, after coalescing
+    int saveRequestCount() const;
+    int performedSaveCount() const;
     // Temporary disable saving. For performance purposes
     void setDisableSaving(bool);
 
-    bool savingInProgress() const;
+    virtual bool savingInProgress() const;
+
+    // Backends can keep old archived tasks out of memory until the archive is shown
+    Q_INVOKABLE void loadArchive();
+    virtual bool archiveLoaded() const;
     bool loadingInProgress() const;
 
     bool webDAVSyncSupported() const;
 
     QByteArray instanceId();
-#ifdef DEVELOPER_MODE
-    Q_INVOKABLE void removeDuplicateData();
-#endif
+    // Drops tasks with an uuid and tags with a name seen earlier in the list. Returns how many.
+    // Runs after every load, call it after merging data from elsewhere too.
+    Q_INVOKABLE int removeDuplicateData();
 
     template <typename T>
-    static inline bool itemListContains(const GenericListModel<T> &list, const T &item)
+    static inline bool itemListContains(const QList<T> &list, const T &item)
     {
         return Storage::indexOfItem(list, item) != -1;
     }
 
     template <typename T>
-    static inline int indexOfItem(const GenericListModel<T> &list, const T &item)
+    static inline int indexOfItem(const QList<T> &list, const T &item)
     {
         for (int i = 0; i < list.count(); i++)
             if (*list.at(i).data() == *item.data())
@@ -124,13 +141,24 @@ public:
     TaskFilterProxyModel* dueDateTasksModel() const;
     TaskFilterProxyModel* stagedTasksModel() const;
     TaskFilterProxyModel* archivedTasksModel() const;
+    const TaskColumns &taskColumns() const; // Same rows as tasks()
     Task::Ptr taskAt(int index) const;
     Task::Ptr addTask(const QString &taskText, const QString &uid = QString());
     Task::Ptr prependTask(const QString &taskText);
     void removeTask(const Task::Ptr &task);
     int indexOfTask(const Task::Ptr &) const;
+    Task::Ptr taskForUuid(const QString &uuid) const;
     void clearTasks();
 //------------------------------------------------------------------------------
+// Dormant tasks are kept as plain TaskRecords, without a Task object, but still count for their
+// tags. Backends use them for old archived tasks. They become regular tasks when something needs them.
+    int dormantTaskCount() const;
+    Q_INVOKABLE void materializeTasksWithTag(const QString &tagName); // Empty name for untagged ones
+    Q_INVOKABLE void materializeAllTasks();
+    Task::Ptr materializeTask(const QString &uuid); // Like taskForUuid(), but also finds dormant tasks
+    // Turns materialized tasks back into records, unless they changed or are being used. Returns how many.
+    int recycleMaterializedTasks(const QList<Task*> &inUse = QList<Task*>());
+//------------------------------------------------------------------------------
 // Stuff for tags
     Q_INVOKABLE bool removeTag(const QString &tagName);
     Q_INVOKABLE Tag::Ptr createTag(const QString &tagName, const QString &uid = QString());
@@ -141,6 +169,8 @@ public:
     bool containsTag(const QString &name) const;
     void clearTags();
     int indexOfTag(const QString &name) const;
+    int internTag(const Tag::Ptr &tag);
+    Tag::Ptr tagForId(int id) const;
 //------------------------------------------------------------------------------
 
     Q_INVOKABLE QString dataFile() const;
@@ -153,6 +183,7 @@ public:
     QAbstractItemModel* nonEmptyTagsModel() const;
     int taskCount() const;
     int ageAverage() const;
+    TaskStatistics *statistics() const;
 
 public Q_SLOTS:
     bool renameTag(const QString &oldName, const QString &newName);
@@ -163,21 +194,69 @@ public Q_SLOTS:
 Q_SIGNALS:
     void taskCountChanged();
     void tagAboutToBeRemoved(const QString &name);
+    void saveFinished(bool success);
 
 private Q_SLOTS:
     void onTagAboutToBeRemoved(const QString &tagName);
+    void onTaskChanged();
+    void onTagsChanged();
+    void onTasksAboutToBeReset();
+    void onTasksReset();
+    void onTaskTagsChanged();
+    void onTaskFilterDataChanged();
+    void onTaskRowChanged();
+    void onTaskStagedChanged();
+    void onTaskDueDateChanged();
+    void onTaskColumnDataChanged();
+    void onTaskRowsInserted(const QModelIndex &parent, int first, int last);
+    void onTaskRowsAboutToBeRemoved(const QModelIndex &parent, int first, int last);
+    void onTaskRowsRemoved(const QModelIndex &parent, int first, int last);
+    void onTaskDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight);
+    void onTaskRowsReset();
+    void onDayChanged();
+    void onTagRowsInserted(const QModelIndex &parent, int first, int last);
+    void onTagsReset();
+    void invalidateTagIndex();
 
 protected:
-    Task::Ptr addTask(const Task::Ptr &task);
+    Task::Ptr addTask(const Task::Ptr &task, int row = -1); // Appended if row is out of range
+    void addTasks(const QList<Task::Ptr> &tasks); // Bulk version, for loading
+    void clearPendingChanges();
+    void addDormantTasks(const QVector<TaskRecord> &records);
+    const QVector<TaskRecord> &dormantTasks() const;
+    void addDormantTagCount(const QString &tagName, int count);
+    // Applies the records of a journal written by JsonStorage. Returns how many were applied.
+    int replayJournalFile(const QString &fileName);
     Data m_data;
     Kernel *m_kernel;
     virtual void load_impl() = 0;
     virtual void save_impl() = 0;
+    virtual void loadArchive_impl();
+
+    // What changed since the last save, for backends that don't need to rewrite everything
+    QHash<QUuid, QWeakPointer<Task> > m_changedTasks; // keyed by Syncable::uuidKey()
+    QStringList m_removedTaskUids;
+    bool m_tagsChanged;
+    bool m_fullSaveRequired; // Set when the changes can't be described incrementally
 
 private:
     void connectTask(const Task::Ptr &);
+    void rebuildTagIndex() const;
+    void indexTasks(const QList<Task::Ptr> &);
+    void unindexTask(const Task::Ptr &);
+    void replaceTask(const Task::Ptr &oldTask, const Task::Ptr &newTask);
+    void materializeDormantTasks(QList<int> indexes);
+    TaskRecord takeDormantTask(int index);
+    void renameDormantTag(const QString &oldName, const QString &newName);
+    void indexDueDate(Task *);
+    void unindexDueDate(Task *);
     int proxyRowToSource(int proxyIndex) const;
+    int rowOfTask(Task *task) const;
+    void updateRowHints(int first, int last);
     QTimer m_scheduleTimer;
+    QElapsedTimer m_oldestUnsavedChange;
+    int m_saveRequestCount;
+    int m_performedSaveCount;
     SortedTagsModel *m_sortedTagModel;
     QString m_deletedTagName;
     int m_savingDisabled;
@@ -190,6 +269,23 @@ private:
     ExtendedTagsModel *m_extendedTagsModel;
     bool m_savingInProgress;
     bool m_loadingInProgress;
+    mutable QHash<QString, int> m_tagIndexByName; // lower-cased name -> row in m_data.tags
+    mutable bool m_tagIndexDirty;
+    QHash<QUuid, Task::Ptr> m_tasksByUuid; // Same tasks as m_data.tasks, keyed by Syncable::uuidKey()
+    QHash<Task*, QList<Tag::Ptr> > m_tagsOfTask; // The inverse of each tag's posting list
+    QHash<Task*, int> m_rowHints; // Kept up to date by the m_data.tasks row signals
+    const bool m_rowLevelFiltering;
+    TaskStatistics *m_statistics;
+    QVector<QWeakPointer<Tag> > m_tagTable; // Indexed by Tag::internId(), slots are never reused
+    QMap<qint64, QList<Task*> > m_tasksByDueDay; // Julian day -> stored tasks due that day
+    QHash<Task*, qint64> m_dueDayOfTask; // So a task can be found in its old bucket
+    bool m_stagedFilterUpdatesBlocked;
+    bool m_stagedFilterUpdatePending;
+    QVector<TaskRecord> m_dormantTasks; // Unordered, removal swaps with the last one
+    QHash<QUuid, int> m_dormantTaskIndexByUuid;
+    QHash<QString, int> m_dormantTagCounts; // lower-cased tag name -> dormant tasks counted in the tag
+    QHash<Task*, int> m_materializedRevisions; // Revision each materialized task had as a record
+    TaskColumns m_taskColumns;
 };
 
 #endif
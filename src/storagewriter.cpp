@@ -0,0 +1,199 @@
+/*
+  This file is part of Flow.
+
+  Copyright (C) 2015 Sérgio Martins <iamsergio@gmail.com>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "storagewriter.h"
+#include "binaryserializer.h"
+#include "jsonstorage.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QSaveFile>
+
+#if defined(Q_OS_UNIX)
+# include <unistd.h>
+#endif
+
+StorageWriter::StorageWriter(const RuntimeConfiguration &config, const QString &journalFileName,
+                             QObject *parent)
+    : QObject(parent)
+    , m_config(config)
+    , m_journalFileName(journalFileName)
+{
+}
+
+QString StorageWriter::backupFileName(const QString &dataFileName, int generation)
+{
+    return dataFileName + "." + QString::number(generation);
+}
+
+void StorageWriter::writeSnapshot(const QVariantMap &root)
+{
+    qint64 size = 0;
+    qint64 bytesWritten = 0;
+    const bool success = writeSnapshotFile(root, size, bytesWritten);
+    emit snapshotWritten(success, size, bytesWritten);
+}
+
+void StorageWriter::writeSnapshotAndArchive(const QVariantMap &root, const QString &archiveFileName,
+                                            const QVariantMap &archiveRoot, const QVariantMap &summary,
+                                            const QVariantList &unarchivedTasks)
+{
+    // Every task must be in a committed file at all times. The archive is written first, still
+    // with the tasks leaving it, and only shrinks once the data file has them.
+    const QVariantList archivedTasks = archiveRoot.value("tasks").toList();
+    const QVariantList firstArchivedTasks = archivedTasks + unarchivedTasks;
+    QVariantMap firstArchiveRoot = archiveRoot;
+    firstArchiveRoot.insert("tasks", firstArchivedTasks);
+    const bool shrinkArchive = !unarchivedTasks.isEmpty() || archivedTasks.isEmpty();
+
+    qint64 size = 0;
+    qint64 bytesWritten = 0;
+    if (!firstArchivedTasks.isEmpty()
+        && !writeArchive(archiveFileName, firstArchiveRoot, summary, bytesWritten)) {
+        // The data file's copy wins when loading, so the old archive can stay
+        QVariantMap fullRoot = root;
+        fullRoot.insert("tasks", root.value("tasks").toList() + archivedTasks);
+        const bool success = writeSnapshotFile(fullRoot, size, bytesWritten);
+        emit snapshotWritten(success, size, bytesWritten);
+        return;
+    }
+
+    const bool success = writeSnapshotFile(root, size, bytesWritten);
+    if (success && shrinkArchive)
+        writeArchive(archiveFileName, archiveRoot, summary, bytesWritten); // Removes it if empty
+    emit snapshotWritten(success, size, bytesWritten);
+}
+
+bool StorageWriter::writeSnapshotFile(const QVariantMap &root, qint64 &size, qint64 &bytesWritten)
+{
+    const QString dataFileName = m_config.dataFileName();
+    const bool binary = m_config.storageFormat() == RuntimeConfiguration::StorageFormatBinary;
+    const QByteArray serializedData = binary ? BinarySerializer::serialize(root)
+                                             : QJsonDocument::fromVariant(root).toJson();
+
+    // QSaveFile writes to a temporary file next to the data file, syncs it to disk on commit()
+    // and then renames it over the old one, so there's always a complete data file
+    QSaveFile file(dataFileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Could not open" << dataFileName << "for writing"
+                   << file.errorString() << file.error();
+        return false;
+    }
+
+    if (file.write(serializedData) != serializedData.size()) {
+        qWarning() << "Could not write" << dataFileName << file.errorString();
+        file.cancelWriting();
+        return false;
+    }
+
+    bytesWritten += rotateBackups();
+
+    if (!file.commit()) {
+        qWarning() << "Could not update" << dataFileName << file.errorString();
+        return false;
+    }
+
+    // The snapshot now has everything the journal had
+    QFile::remove(m_journalFileName);
+    size = serializedData.size();
+    bytesWritten += serializedData.size();
+    return true;
+}
+
+qint64 StorageWriter::rotateBackups()
+{
+    const int generations = m_config.backupGenerations();
+    const QString dataFileName = m_config.dataFileName();
+    if (generations <= 0 || !QFile::exists(dataFileName))
+        return 0;
+
+    QFile::remove(backupFileName(dataFileName, generations));
+    for (int i = generations - 1; i >= 1; --i)
+        QFile::rename(backupFileName(dataFileName, i), backupFileName(dataFileName, i + 1));
+
+    // The current data file becomes the newest backup. A hard link costs no I/O and
+    // survives the rename done by QSaveFile::commit()
+    const QString backup = backupFileName(dataFileName, 1);
+#if defined(Q_OS_UNIX)
+    if (::link(QFile::encodeName(dataFileName).constData(), QFile::encodeName(backup).constData()) == 0)
+        return 0;
+#endif
+
+    if (!QFile::copy(dataFileName, backup)) {
+        qWarning() << "Could not create backup" << backup;
+        return 0;
+    }
+
+    return QFileInfo(backup).size();
+}
+
+void StorageWriter::appendToJournal(const QByteArray &records)
+{
+    QFile file(m_journalFileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qWarning() << "Could not open" << m_journalFileName << "for appending"
+                   << file.errorString() << file.error();
+        emit journalAppended(false, 0);
+        return;
+    }
+
+    const qint64 bytesWritten = file.write(records);
+    if (bytesWritten != records.size()) {
+        qWarning() << "Could not append to" << m_journalFileName << file.errorString();
+        emit journalAppended(false, qMax(bytesWritten, qint64(0)));
+        return;
+    }
+
+    emit journalAppended(true, bytesWritten);
+}
+
+bool StorageWriter::writeArchive(const QString &fileName, const QVariantMap &root,
+                                 const QVariantMap &summary, qint64 &bytesWritten)
+{
+    if (root.value("tasks").toList().isEmpty()) {
+        if (!QFile::exists(fileName))
+            return true;
+        if (!QFile::remove(fileName))
+            return false;
+        emit archiveRemoved();
+        return true;
+    }
+
+    const QByteArray serializedData = JsonStorage::serializeArchive(root, summary);
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly) || file.write(serializedData) != serializedData.size()) {
+        qWarning() << "Could not write" << fileName << file.errorString();
+        file.cancelWriting();
+        return false;
+    }
+
+    if (!file.commit()) {
+        qWarning() << "Could not update" << fileName << file.errorString();
+        return false;
+    }
+
+    bytesWritten += serializedData.size();
+    return true;
+}
+
+void StorageWriter::flush()
+{
+}
@@ -0,0 +1,67 @@
+/*
+  This file is part of Flow.
+
+  Copyright (C) 2015 Sérgio Martins <iamsergio@gmail.com>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FLOW_STORAGEWRITER_H
+#define FLOW_STORAGEWRITER_H
+
+#include "runtimeconfiguration.h"
+
+#include <QObject>
+#include <QVariantMap>
+
+// Lives in JsonStorage's writer thread. Receives an immutable snapshot of the data and
+// does the expensive part of saving (serialization and disk I/O) away from the GUI thread.
+// Requests are processed in the order they were queued.
+class StorageWriter : public QObject
+{
+    Q_OBJECT
+public:
+    StorageWriter(const RuntimeConfiguration &config, const QString &journalFileName,
+                  QObject *parent = 0);
+
+    static QString backupFileName(const QString &dataFileName, int generation);
+
+public Q_SLOTS:
+    void writeSnapshot(const QVariantMap &root);
+    void appendToJournal(const QByteArray &records);
+    // unarchivedTasks are in the data snapshot but were in the archive file, which only drops
+    // them once the snapshot is committed. If the archive can't be written the archived tasks
+    // go to the data file instead.
+    void writeSnapshotAndArchive(const QVariantMap &root, const QString &archiveFileName,
+                                 const QVariantMap &archiveRoot, const QVariantMap &summary,
+                                 const QVariantList &unarchivedTasks);
+    void flush(); // no-op, for synchronizing with the writer thread
+
+Q_SIGNALS:
+    // bytesWritten counts everything written to disk, including backups
+    void snapshotWritten(bool success, qint64 size, qint64 bytesWritten);
+    void journalAppended(bool success, qint64 bytesWritten);
+    void archiveRemoved(); // It had no tasks left
+
+private:
+    // The bytes written are added to bytesWritten, so several files can be counted together
+    bool writeSnapshotFile(const QVariantMap &root, qint64 &size, qint64 &bytesWritten);
+    bool writeArchive(const QString &fileName, const QVariantMap &root, const QVariantMap &summary,
+                      qint64 &bytesWritten);
+    qint64 rotateBackups();
+    const RuntimeConfiguration m_config;
+    const QString m_journalFileName;
+};
+
+#endif
@@ -20,6 +20,21 @@
 #include "syncable.h"
 #include <QUuid>
 
+// Null unless QUuid::toString() would give back this very string, checked without formatting one
+static QUuid canonicalUuid(const QString &uuid)
+{
+    if (uuid.size() != 38 || uuid.at(0) != QLatin1Char('{') || uuid.at(37) != QLatin1Char('}'))
+        return QUuid();
+
+    for (int i = 1; i < 37; ++i) {
+        const QChar c = uuid.at(i);
+        if (c >= QLatin1Char('A') && c <= QLatin1Char('F'))
+            return QUuid();
+    }
+
+    return QUuid(uuid);
+}
+
 Syncable::Syncable()
     : m_revision(0)
     , m_revisionOnWebDAVServer(-1)
@@ -48,30 +63,67 @@ void Syncable::setRevisionOnWebDAVServer(int revision)
 
 QString Syncable::uuid() const
 {
-    if (m_uuid.isEmpty()) // Delayed creation, since it can be expensive and we don't need to create it in CTOR because it's going to be set when loading
-        m_uuid = QUuid::createUuid().toString();
+    ensureUuid();
+    return m_uuidString.isEmpty() ? m_uuid.toString() : m_uuidString;
+}
 
+QUuid Syncable::uuidKey() const
+{
+    ensureUuid();
     return m_uuid;
 }
 
+void Syncable::ensureUuid() const
+{
+    if (m_uuid.isNull() && m_uuidString.isEmpty()) // Delayed creation, since it can be expensive and we don't need to create it in CTOR because it's going to be set when loading
+        m_uuid = QUuid::createUuid();
+}
+
 void Syncable::fromJson(const QVariantMap &map)
 {
-    QString uuid = map.value("uuid").toString();
-    if (uuid.isEmpty())
-        uuid = QUuid::createUuid().toString();
-    setUuid(uuid);
-    setRevision(map.value("revision", 0).toInt());
-    setRevisionOnWebDAVServer(map.value("revisionOnWebDAVServer", -1).toInt());
+    setSyncData(map.value("uuid").toString(), map.value("revision", 0).toInt(),
+                map.value("revisionOnWebDAVServer", -1).toInt());
+}
+
+void Syncable::setSyncData(const QString &uuid, int revision, int revisionOnWebDAVServer)
+{
+    if (uuid.isEmpty()) {
+        m_uuid = QUuid::createUuid();
+        m_uuidString.clear();
+    } else {
+        setUuid(uuid);
+    }
+    setRevision(revision);
+    setRevisionOnWebDAVServer(revisionOnWebDAVServer);
 }
 
 void Syncable::setUuid(const QString &uuid)
 {
-    m_uuid = uuid;
+    const QUuid binaryUuid = canonicalUuid(uuid);
+    m_uuid = binaryUuid.isNull() ? keyForUuid(uuid) : binaryUuid;
+    m_uuidString = binaryUuid.isNull() ? uuid : QString();
+}
+
+QUuid Syncable::keyForUuid(const QString &uuid)
+{
+    if (uuid.isEmpty())
+        return QUuid();
+
+    // Data written by others might have uppercase or unbraced uuids, those are kept as they are
+    // and keyed by a name based uuid, so spelling one differently is still another uuid
+    static const QUuid nonCanonicalNamespace(0x3c1f5a2e, 0x8d4b, 0x4e07, 0x9a, 0x61, 0x2f, 0x0b, 0xd8, 0x51, 0xc7, 0x3e);
+    const QUuid binaryUuid = canonicalUuid(uuid);
+    return binaryUuid.isNull() ? QUuid::createUuidV5(nonCanonicalNamespace, uuid) : binaryUuid;
 }
 
 bool Syncable::equals(Syncable *other) const
 {
-    return other && m_uuid == other->uuid();
+    return other && hasSameUuid(*other);
+}
+
+bool Syncable::hasSameUuid(const Syncable &other) const
+{
+    return uuidKey() == other.uuidKey();
 }
 
 void Syncable::setRevision(int revision)
@@ -21,6 +21,7 @@
 #define FLOW_SYNCABLE_H
 
 #include <QString>
+#include <QUuid>
 #include <QVariantMap>
 
 class Syncable
@@ -32,17 +33,24 @@ public:
     int revision() const;
     int revisionOnWebDAVServer() const;
     void setRevisionOnWebDAVServer(int);
-    QString uuid() const;
+    QString uuid() const; // Formatted on each call, containers are keyed by uuidKey()
+    QUuid uuidKey() const;
     void setUuid(const QString &uuid);
+    static QUuid keyForUuid(const QString &uuid); // The uuidKey() of an item with this uuid
 
     virtual void fromJson(const QVariantMap &);
 protected:
     bool equals(Syncable *) const;
+    bool hasSameUuid(const Syncable &other) const; // Doesn't format any uuid
     void setRevision(int);
+    void setSyncData(const QString &uuid, int revision, int revisionOnWebDAVServer);
     virtual QVariantMap toJson() const;
     int m_revision;
     int m_revisionOnWebDAVServer;
-    mutable QString m_uuid;
+private:
+    void ensureUuid() const;
+    mutable QUuid m_uuid; // Only formatted as a string when asked for
+    QString m_uuidString; // Set only for uuids QUuid wouldn't format back identically
 };
 
 #endif
@@ -18,7 +18,7 @@
 */
 
 #include "tag.h"
-#include "taskfilterproxymodel.h"
+#include "task.h"
 #include "taskfilterproxymodel.h"
 #if defined(UNIT_TEST_RUN)
 # include "assertingproxymodel.h"
@@ -32,6 +32,18 @@
     int Tag::tagCount = 0;
 #endif
 
+static QVariant taggedTasksDataFunction(const GenericListModel<Task*> &list, int index, int role)
+{
+    switch (role) {
+    case Storage::TaskRole:
+        return QVariant::fromValue<Task*>(list.at(index));
+    case Storage::TaskPtrRole:
+        return QVariant::fromValue<Task::Ptr>(list.at(index)->toStrongRef());
+    default:
+        return QVariant();
+    }
+}
+
 Tag::Tag(Kernel *kernel, const QString &name)
     : QObject()
     , Syncable()
@@ -42,8 +54,12 @@ Tag::Tag(Kernel *kernel, const QString &name)
     , m_kernel(kernel)
     , m_isFake(false)
     , m_dontUpdateRevision(false)
+    , m_internId(-1)
 {
     QQmlEngine::setObjectOwnership(this, QQmlEngine::CppOwnership);
+    m_taggedTasks.setDataFunction(&taggedTasksDataFunction);
+    m_taggedTasks.insertRole("task", Q_NULLPTR, Storage::TaskRole);
+    m_taggedTasks.insertRole("taskPtr", Q_NULLPTR, Storage::TaskPtrRole);
 #if defined(QT_TESTLIB_LIB)
     tagCount++;
     // qDebug() << "[TAG] CTOR " << ((void*)this) << m_name;
@@ -60,6 +76,7 @@ Tag::Tag(const QString &name, QAbstractItemModel *taskModel)
     , m_kernel(Q_NULLPTR)
     , m_isFake(true)
     , m_dontUpdateRevision(true)
+    , m_internId(-1)
 {
 }
 
@@ -121,15 +138,12 @@ void Tag::setBeingEdited(bool yes)
 QAbstractItemModel *Tag::taskModel()
 {
     if (!m_taskModel && !m_isFake) {
+        // Only looks at the tasks having this tag, instead of filtering every archived task
         TaskFilterProxyModel *model = new TaskFilterProxyModel(this);
-        model->setTagName(m_name);
-        model->setSourceModel(m_kernel->storage()->archivedTasksModel());
+        model->setFilterArchived(true);
+        model->setSourceModel(m_taggedTasks);
         model->setObjectName(QString("Tasks with tag %1 model").arg(m_name));
         m_taskModel = model;
-
-        connect(this, &Tag::taskCountChanged,
-                model, &TaskFilterProxyModel::invalidateFilter,
-                Qt::QueuedConnection);
 #if defined(UNIT_TEST_RUN)
         AssertingProxyModel *assert = new AssertingProxyModel(this);
         assert->setSourceModel(m_taskModel);
@@ -139,6 +153,35 @@ QAbstractItemModel *Tag::taskModel()
     return m_taskModel;
 }
 
+void Tag::addTaggedTasks(const QList<Task*> &tasks)
+{
+    Q_ASSERT(!m_isFake);
+    m_taggedTasks.append(tasks); // Storage doesn't add the same task twice
+}
+
+void Tag::removeTaggedTask(Task *task)
+{
+    m_taggedTasks.removeOne(task);
+}
+
+void Tag::taggedTaskChanged(Task *task)
+{
+    const int index = m_taggedTasks.indexOf(task);
+    if (index != -1)
+        m_taggedTasks.replace(index, task); // emits dataChanged
+}
+
+void Tag::clearTaggedTasks()
+{
+    if (!m_taggedTasks.isEmpty())
+        m_taggedTasks.clear();
+}
+
+QList<Task*> Tag::taggedTasks() const
+{
+    return m_taggedTasks;
+}
+
 QVariantMap Tag::toJson() const
 {
     Q_ASSERT(!m_isFake);
@@ -148,22 +191,36 @@ QVariantMap Tag::toJson() const
 }
 
 void Tag::fromJson(const QVariantMap &map)
+{
+    fromRecord(recordFromJson(map));
+}
+
+TagRecord Tag::recordFromJson(const QVariantMap &map)
+{
+    TagRecord record;
+    record.uuid = map.value("uuid").toString();
+    record.revision = map.value("revision", 0).toInt();
+    record.revisionOnWebDAVServer = map.value("revisionOnWebDAVServer", -1).toInt();
+    record.name = map.value("name").toString();
+    return record;
+}
+
+void Tag::fromRecord(const TagRecord &record)
 {
     Q_ASSERT(!m_isFake);
-    Syncable::fromJson(map);
-    QString name = map.value("name").toString();
-    if (name.isEmpty()) {
+    setSyncData(record.uuid, record.revision, record.revisionOnWebDAVServer);
+    if (record.name.isEmpty()) {
         qWarning() << Q_FUNC_INFO << "empty tag name";
     } else {
         m_dontUpdateRevision = true;
-        setName(name);
+        setName(record.name);
         m_dontUpdateRevision = false;
     }
 }
 
 bool Tag::operator==(const Tag &other) const
 {
-    return m_uuid == other.uuid() || m_name == other.m_name;
+    return hasSameUuid(other) || m_name == other.m_name;
 }
 
 Kernel *Tag::kernel() const
@@ -183,6 +240,11 @@ bool Tag::isFake() const
     return m_isFake;
 }
 
+int Tag::internId() const
+{
+    return m_internId;
+}
+
 bool Tag::equals(Tag *other) const
 {
     return Syncable::equals(other) && m_name.trimmed().toLower() == other->name().trimmed().toLower();
@@ -22,12 +22,14 @@
 
 #include "genericlistmodel.h"
 #include "syncable.h"
+#include "taskrecord.h"
 
 #include <QString>
 #include <QSharedPointer>
 
 class TaskFilterProxyModel;
 class Kernel;
+class Task;
 
 class Tag : public QObject, public Syncable
 {
@@ -52,13 +54,24 @@ public:
     void setBeingEdited(bool);
 
     QAbstractItemModel* taskModel();
+
+    // Posting list with the stored tasks having this tag, maintained by Storage.
+    // taskModel() filters and sorts it.
+    void addTaggedTasks(const QList<Task*> &);
+    void removeTaggedTask(Task *);
+    void taggedTaskChanged(Task *); // So taskModel() filters and sorts it again
+    void clearTaggedTasks();
+    QList<Task*> taggedTasks() const;
     QVariantMap toJson() const Q_DECL_OVERRIDE;
     void fromJson(const QVariantMap &) Q_DECL_OVERRIDE;
+    void fromRecord(const TagRecord &);
+    static TagRecord recordFromJson(const QVariantMap &); // thread-safe
 
     bool operator==(const Tag &other) const;
     Kernel *kernel() const;
     void setKernel(Kernel *kernel);
     bool isFake() const;
+    int internId() const; // Slot in the storage's tag table, see Storage::internTag()
 
 #if defined(QT_TESTLIB_LIB)
     static int tagCount;
@@ -81,9 +94,12 @@ private:
     int m_taskCount;
     bool m_beingEdited;
     QAbstractItemModel *m_taskModel; // All unstaged tasks with this tag
+    GenericListModel<Task*> m_taggedTasks;
     Kernel *m_kernel;
     bool m_isFake;
     bool m_dontUpdateRevision;
+    int m_internId;
+    friend class Storage;
 };
 
 bool operator==(const Tag::Ptr &, const Tag::Ptr &);
@@ -22,65 +22,24 @@
 #include "task.h"
 #include "kernel.h"
 
-TagRef::TagRef(const TagRef &other)
-{
-    m_task = other.m_task;
-    m_tagName = other.m_tagName;
-    m_temporary = false;
-    m_tag = other.m_tag;
-    m_storage = other.m_storage;
-
-    Q_ASSERT(!m_tagName.isEmpty());
-    incrementCount();
-}
-
-TagRef TagRef::operator=(const TagRef &other)
-{
-    if (m_storage != other.m_storage && m_storage) {
-        qWarning() << "Invalid storages" << m_storage << other.m_storage;
-        Q_ASSERT(false);
-    }
-
-    decrementCount();
-
-    m_task = other.m_task;
-    m_tagName = other.m_tagName;
-    m_tag = other.m_tag;
-    m_storage = other.m_storage;
-
-    incrementCount();
-
-    return *this;
-}
-
-// Temporary is a performance optimization, we don't want to emit uneeded signals
-// when temporaries are constructed while appending TagRefs into a list
-TagRef::TagRef(const QPointer<Task> &task, const QString &tagName,
-               Storage *storage, bool temporary)
+TagRef::TagRef(const QPointer<Task> &task, const QString &tagName, Storage *storage)
     : m_task(task)
     , m_tagName(tagName)
-    , m_temporary(temporary)
     , m_storage(storage)
+    , m_tagId(-1)
 {
     Q_ASSERT(!tagName.isEmpty());
 
     if (m_storage) {
-        m_tag = m_storage->tag(tagName); // Create if it doesn't exist
-
-        if (!temporary)
-            incrementCount();
+        Tag::Ptr tag = m_storage->tag(tagName); // Create if it doesn't exist
+        if (tag)
+            m_tagId = m_storage->internTag(tag);
     }
 }
 
-TagRef::~TagRef()
-{
-    if (!m_temporary)
-        decrementCount();
-}
-
 Tag::Ptr TagRef::tag() const
 {
-    return m_tag;
+    return m_storage ? m_storage->tagForId(m_tagId) : Tag::Ptr();
 }
 
 Storage *TagRef::storage() const
@@ -88,21 +47,18 @@ Storage *TagRef::storage() const
     return m_storage;
 }
 
-void TagRef::setStorage(Storage *storage)
+QString TagRef::tagName() const
 {
-    Q_ASSERT(storage && !m_storage);
-    m_storage = storage;
-    m_tag = m_storage->tag(m_tagName);
-    if (!m_temporary)
-        incrementCount();
+    Tag::Ptr tag = this->tag();
+    return tag ? tag->name() : m_tagName;
 }
 
-QString TagRef::tagName() const
+int TagRef::tagId() const
 {
-    return m_tag ? m_tag->name() : m_tagName;
+    return m_tagId;
 }
 
-void TagRef::incrementCount()
+void TagRef::incrementCount() const
 {
     Tag::Ptr tag = this->tag();
     if (!tag)
@@ -112,7 +68,7 @@ void TagRef::incrementCount()
     QObject::connect(tag.data(), &Tag::nameChanged, m_task.data(), &Task::changed);
 }
 
-void TagRef::decrementCount()
+void TagRef::decrementCount() const
 {
     Tag::Ptr tag = this->tag();
     if (!tag)
@@ -27,32 +27,29 @@
 class Task;
 class Storage;
 
+// A tag of a task. It's a plain value: copying or destroying one doesn't touch the tag's
+// task count nor any connections, Task does that when a tag is actually added or removed.
 class TagRef
 {
 public:
     typedef GenericListModel<TagRef> List;
 
-    TagRef(const TagRef &other);
-    TagRef operator=(const TagRef &);
-    TagRef(const QPointer<Task> &task,
-           const QString &tagName, Storage *storage,
-           bool temporary = false);
-    ~TagRef();
+    TagRef(const QPointer<Task> &task, const QString &tagName, Storage *storage);
 
     Tag::Ptr tag() const;
     Storage *storage() const;
-    void setStorage(Storage *);
     QString tagName() const;
+    int tagId() const; // Handle into the storage's tag table, -1 without storage
 
     QPointer<Task> m_task;
 private:
     TagRef();
-    void incrementCount();
-    void decrementCount();
+    void incrementCount() const;
+    void decrementCount() const;
     QString m_tagName;
-    bool m_temporary;
     Storage *m_storage;
-    Tag::Ptr m_tag;
+    int m_tagId;
+    friend class Task;
 };
 
 #endif
@@ -32,6 +32,7 @@
 #include <QQmlEngine>
 #include <QUuid>
 
+
 #if defined(UNIT_TEST_RUN)
     int Task::taskCount;
 #endif
@@ -41,6 +42,18 @@ enum {
     TaskRole
 };
 
+static const qint64 NoTimestamp = TaskRecord::NoTimestamp;
+
+static qint64 toTimestamp(const QDateTime &date)
+{
+    return date.isValid() ? date.toMSecsSinceEpoch() : NoTimestamp;
+}
+
+static QDateTime toDateTime(qint64 timestamp)
+{
+    return timestamp == NoTimestamp ? QDateTime() : QDateTime::fromMSecsSinceEpoch(timestamp, Qt::UTC);
+}
+
 static QVariant dataFunction(const TagRef::List &list, int index, int role)
 {
     switch (role) {
@@ -60,14 +73,17 @@ Task::Task(Kernel *kernel, const QString &summary)
     , m_checkableTagModel(0)
     , m_status(TaskStopped)
     , m_staged(false)
-    , m_creationDate(QDateTime::currentDateTimeUtc())
-    , m_modificationDate(m_creationDate)
+    , m_creationTimestamp(QDateTime::currentMSecsSinceEpoch())
+    , m_modificationTimestamp(m_creationTimestamp)
+    , m_lastPomodoroTimestamp(NoTimestamp)
     , m_contextMenuModel(0)
     , m_sortedContextMenuModel(0)
     , m_kernel(kernel)
     , m_priority(PriorityNone)
+    , m_sortKey(0)
 {
     QQmlEngine::setObjectOwnership(this, QQmlEngine::CppOwnership);
+    updateSortKey();
 
     connect(this, &Task::summaryChanged, &Task::onEdited);
     connect(this, &Task::tagsChanged, &Task::onEdited);
@@ -77,22 +93,16 @@ Task::Task(Kernel *kernel, const QString &summary)
     connect(this, &Task::dueDateChanged, &Task::onEdited);
     connect(this, &Task::priorityChanged, &Task::onEdited);
 
-    connect(kernel, &Kernel::dayChanged, this, &Task::onDayChanged);
-
 #if defined(UNIT_TEST_RUN)
     taskCount++;
 #endif
 
-    if (kernel)
+    if (kernel) // null when only deserializing
         modelSetup();
 }
 
 void Task::modelSetup()
 {
-    Storage *storage = m_kernel->storage();
-
-    m_checkableTagModel = new CheckableTagModel(this);
-
     m_tags.setDataFunction(&dataFunction);
     m_tags.insertRole("tag", Q_NULLPTR, TagRole);
     m_tags.insertRole("task", Q_NULLPTR, TaskRole);
@@ -104,29 +114,66 @@ void Task::modelSetup()
     connect(tagsModel, &QAbstractListModel::layoutChanged, this, &Task::tagsChanged);
     connect(tagsModel, &QAbstractListModel::dataChanged, this, &Task::tagsChanged);
 
-    QHash<int, QByteArray> roleNames = storage->tagsModel()->roleNames();
-    roleNames.insert(Qt::CheckStateRole, QByteArray("checkState"));
-    QAbstractItemModel *allTagsModel = storage->tagsModel();
+#if defined(UNIT_TEST_RUN)
+    AssertingProxyModel *assert = new AssertingProxyModel(this);
+    assert->setSourceModel(m_tags);
+#endif
+}
+
+// The menu models proxy the global tags model, so with many tasks having them all alive
+// costs memory and a signal per task on every tag change. They're only needed while
+// a context menu is open, so they're created on first access and released afterwards.
+void Task::createMenuModels() const
+{
+    if (m_checkableTagModel || !m_kernel)
+        return;
+
+    Task *self = const_cast<Task*>(this);
+    QAbstractItemModel *allTagsModel = m_kernel->storage()->tagsModel();
     Q_ASSERT(allTagsModel);
+    m_checkableTagModel = new CheckableTagModel(self);
     m_checkableTagModel->setSourceModel(allTagsModel);
-    m_contextMenuModel = new TaskContextMenuModel(this, this);
-    m_sortedContextMenuModel = new SortedTaskContextMenuModel(this);
+    m_contextMenuModel = new TaskContextMenuModel(self, m_checkableTagModel, self);
+    m_sortedContextMenuModel = new SortedTaskContextMenuModel(self);
     m_sortedContextMenuModel->setSourceModel(m_contextMenuModel);
 
 #if defined(UNIT_TEST_RUN)
-    AssertingProxyModel *assert = new AssertingProxyModel(this);
+    AssertingProxyModel *assert = new AssertingProxyModel(m_contextMenuModel);
     assert->setSourceModel(m_contextMenuModel);
-    assert = new AssertingProxyModel(this);
+    assert = new AssertingProxyModel(m_sortedContextMenuModel);
     assert->setSourceModel(m_sortedContextMenuModel);
-    assert = new AssertingProxyModel(this);
+    assert = new AssertingProxyModel(m_checkableTagModel);
     assert->setSourceModel(m_checkableTagModel);
-    assert = new AssertingProxyModel(this);
-    assert->setSourceModel(m_tags);
 #endif
+
+    emit self->menuModelsChanged();
+}
+
+void Task::releaseMenuModels()
+{
+    if (!m_checkableTagModel)
+        return;
+
+    // QML might still be looking at them until the next event loop pass
+    m_sortedContextMenuModel->deleteLater();
+    m_contextMenuModel->deleteLater();
+    m_checkableTagModel->deleteLater();
+    m_sortedContextMenuModel = Q_NULLPTR;
+    m_contextMenuModel = Q_NULLPTR;
+    m_checkableTagModel = Q_NULLPTR;
+    emit menuModelsChanged();
+}
+
+bool Task::hasMenuModels() const
+{
+    return m_checkableTagModel;
 }
 
 Task::~Task()
 {
+    for (int i = 0; i < m_tags.count(); ++i)
+        m_tags.at(i).decrementCount();
+
 #if defined(UNIT_TEST_RUN)
     taskCount--;
 #endif
@@ -197,15 +244,18 @@ int Task::indexOfTag(const QString &name) const
     return -1;
 }
 
-TagRef::List Task::tags() const
+const QList<TagRef> &Task::tags() const
 {
     return m_tags;
 }
 
 void Task::setTagList(const TagRef::List &list)
 {
-    if (!m_tags.isEmpty()) // No need to emit uneeded signals
+    if (!m_tags.isEmpty()) { // No need to emit uneeded signals
+        for (int i = 0; i < m_tags.count(); ++i)
+            m_tags.at(i).decrementCount();
         m_tags.clear();
+    }
 
     // Filter out duplicated tags
     QStringList addedTags;
@@ -213,7 +263,10 @@ void Task::setTagList(const TagRef::List &list)
         QString name = ref.tagName().toLower();
         if (!addedTags.contains(name) && !name.isEmpty()) {
             addedTags << name;
-            m_tags << ref;
+            TagRef ownRef = ref;
+            ownRef.m_task = this;
+            m_tags << ownRef;
+            ownRef.incrementCount();
         }
     }
 }
@@ -225,6 +278,7 @@ QAbstractItemModel *Task::tagModel() const
 
 QAbstractItemModel *Task::checkableTagModel() const
 {
+    createMenuModels();
     return m_checkableTagModel;
 }
 
@@ -235,7 +289,9 @@ void Task::addTag(const QString &tagName)
         return;
 
     if (!containsTag(trimmedName)) {
-        m_tags.append(TagRef(this, trimmedName, storage(), /*temporary=*/ true));
+        const TagRef ref(this, trimmedName, storage());
+        m_tags.append(ref);
+        ref.incrementCount();
         emit tagToggled(trimmedName);
     }
 }
@@ -244,6 +300,7 @@ void Task::removeTag(const QString &tagName)
 {
     int index = indexOfTag(tagName);
     if (index != -1) {
+        m_tags.at(index).decrementCount();
         m_tags.removeAt(index);
         emit tagToggled(tagName);
     }
@@ -276,37 +333,28 @@ void Task::setStatus(TaskStatus status)
     }
 }
 
-void Task::setCreationDate(const QDateTime &date)
-{
-    m_creationDate = date;
-}
-
 void Task::setLastPomodoroDate(const QDateTime &date)
 {
-    if (date != m_lastPomodoroDate) {
-        m_lastPomodoroDate = date;
+    const qint64 timestamp = toTimestamp(date);
+    if (timestamp != m_lastPomodoroTimestamp) {
+        m_lastPomodoroTimestamp = timestamp;
         emit daysSinceLastPomodoroChanged();
     }
 }
 
 QDateTime Task::creationDate() const
 {
-    return m_creationDate;
-}
-
-void Task::setModificationDate(const QDateTime &date)
-{
-    m_modificationDate = date;
+    return toDateTime(m_creationTimestamp);
 }
 
 QDateTime Task::modificationDate() const
 {
-    return m_modificationDate;
+    return toDateTime(m_modificationTimestamp);
 }
 
 QDateTime Task::lastPomodoroDate() const
 {
-    return m_lastPomodoroDate;
+    return toDateTime(m_lastPomodoroTimestamp);
 }
 
 QDate Task::dueDate() const
@@ -319,6 +367,7 @@ void Task::setDueDate(const QDate &date)
     if (date != m_dueDate) {
         m_dueDate = date;
         emit dueDateChanged();
+        emit dueStatusChanged();
     }
 }
 
@@ -350,36 +399,98 @@ void Task::setWeakPointer(const QWeakPointer<Task> &ptr)
 
 QVariantMap Task::toJson() const
 {
-    QVariantMap map = Syncable::toJson();
-    map.insert("summary", m_summary);
-    map.insert("staged", m_staged);
-    map.insert("description", m_description);
-    QVariantList tags;
+    // Dormant tasks only have a record, going through it keeps both serialized the same way
+    return recordToJson(toRecord());
+}
+
+void Task::fromJson(const QVariantMap &map)
+{
+    fromRecord(recordFromJson(map));
+}
+
+TaskRecord Task::toRecord() const
+{
+    TaskRecord record;
+    record.uuid = uuid();
+    record.revision = m_revision;
+    record.revisionOnWebDAVServer = m_revisionOnWebDAVServer;
+    record.summary = m_summary;
+    record.description = m_description;
+    record.staged = m_staged;
+    record.priority = m_priority;
+    if (m_creationTimestamp != NoTimestamp)
+        record.creationTimestamp = m_creationTimestamp;
+    record.modificationTimestamp = m_modificationTimestamp;
+    record.lastPomodoroTimestamp = m_lastPomodoroTimestamp;
+    if (m_dueDate.isValid()) {
+        record.hasDueDate = true;
+        record.dueDate = m_dueDate.toJulianDay();
+    }
+
     for (int i = 0; i < m_tags.count(); ++i)
-        tags << m_tags.at(i).tagName();
+        record.tags << m_tags.at(i).tagName();
+
+    return record;
+}
+
+TaskRecord Task::recordFromJson(const QVariantMap &map)
+{
+    TaskRecord record;
+    record.uuid = map.value("uuid").toString();
+    record.revision = map.value("revision", 0).toInt();
+    record.revisionOnWebDAVServer = map.value("revisionOnWebDAVServer", -1).toInt();
+    record.summary = map.value("summary").toString();
+    record.description = map.value("description").toString();
+    record.staged = map.value("staged", false).toBool();
+    record.priority = map.value("priority", PriorityNone).toInt();
+    record.creationTimestamp = map.value("creationTimestamp", QDateTime()).toLongLong();
+    record.modificationTimestamp = map.value("modificationTimestamp", QDateTime()).toLongLong();
+    record.lastPomodoroTimestamp = map.value("lastPomodoroDate", QDateTime()).toLongLong();
+    record.hasDueDate = map.contains("dueDate");
+    record.dueDate = map.value("dueDate").toLongLong();
+
+    const QVariantList tagsVariant = map.value("tags").toList();
+    foreach (const QVariant &tag, tagsVariant)
+        record.tags << tag.toString();
+
+    return record;
+}
+
+QVariantMap Task::recordToJson(const TaskRecord &record)
+{
+    QVariantMap map;
+    map.insert("revision", record.revision);
+    map.insert("revisionOnWebDAVServer", record.revisionOnWebDAVServer);
+    map.insert("uuid", record.uuid);
+    map.insert("summary", record.summary);
+    map.insert("staged", record.staged);
+    map.insert("description", record.description);
+    QVariantList tags;
+    foreach (const QString &tag, record.tags)
+        tags << tag;
     map.insert("tags", tags);
-    map.insert("creationTimestamp", m_creationDate.toMSecsSinceEpoch());
+    map.insert("creationTimestamp", record.creationTimestamp);
 
-    if (m_modificationDate.isValid())
-        map.insert("modificationTimestamp", m_modificationDate.toMSecsSinceEpoch());
+    if (record.modificationTimestamp != TaskRecord::NoTimestamp)
+        map.insert("modificationTimestamp", record.modificationTimestamp);
 
-    if (m_lastPomodoroDate.isValid())
-        map.insert("lastPomodoroDate", m_lastPomodoroDate.toMSecsSinceEpoch());
+    if (record.lastPomodoroTimestamp != TaskRecord::NoTimestamp)
+        map.insert("lastPomodoroDate", record.lastPomodoroTimestamp);
 
-    if (m_dueDate.isValid())
-        map.insert("dueDate", m_dueDate.toJulianDay());
+    if (record.hasDueDate)
+        map.insert("dueDate", record.dueDate);
 
-    if (m_priority != PriorityNone)
-        map.insert("priority", QVariant(m_priority));
+    if (record.priority != PriorityNone)
+        map.insert("priority", QVariant(record.priority));
 
     return map;
 }
 
-void Task::fromJson(const QVariantMap &map)
+void Task::fromRecord(const TaskRecord &record)
 {
-    Syncable::fromJson(map);
+    setSyncData(record.uuid, record.revision, record.revisionOnWebDAVServer);
 
-    QString summary = map.value("summary").toString();
+    QString summary = record.summary;
     if (summary.isEmpty()) {
         qWarning() << Q_FUNC_INFO << "empty task summary";
         summary = tr("New Task");
@@ -387,35 +498,26 @@ void Task::fromJson(const QVariantMap &map)
 
     blockSignals(true); // so we don't increment revision while calling setters
     setSummary(summary);
-
-    QString description = map.value("description").toString();
-    setDescription(description);
-    setStaged(map.value("staged", false).toBool());
-    setPriority(static_cast<Priority>(map.value("priority", PriorityNone).toInt()));
-
-    QDateTime creationDate = QDateTime::fromMSecsSinceEpoch(map.value("creationTimestamp", QDateTime()).toLongLong());
-    if (creationDate.isValid()) // If invalid it uses the ones set in CTOR
-        setCreationDate(creationDate);
-
-    QDateTime modificationDate = QDateTime::fromMSecsSinceEpoch(map.value("modificationTimestamp", QDateTime()).toLongLong());
-    if (modificationDate.isValid())
-        setModificationDate(modificationDate);
-
-    QDateTime lastPomodoroDate = QDateTime::fromMSecsSinceEpoch(map.value("lastPomodoroDate", QDateTime()).toLongLong());
-    if (lastPomodoroDate.isValid())
-        setLastPomodoroDate(lastPomodoroDate);
-
-    if (map.contains("dueDate")) { // from julian of QDate() then toJulian returns a valid date, so check map
-        QDate dueDate = QDate::fromJulianDay(map.value("dueDate").toLongLong());
+    setDescription(record.description);
+    setStaged(record.staged);
+    setPriority(static_cast<Priority>(record.priority));
+
+    // Same representation, no need to go through QDateTime
+    m_creationTimestamp = record.creationTimestamp;
+    m_modificationTimestamp = record.modificationTimestamp;
+    m_lastPomodoroTimestamp = record.lastPomodoroTimestamp;
+    updateSortKey();
+
+    if (record.hasDueDate) { // from julian of QDate() then toJulian returns a valid date, so check presence
+        QDate dueDate = QDate::fromJulianDay(record.dueDate);
         if (dueDate.isValid() && dueDate.toJulianDay() != 0)
             setDueDate(dueDate);
     }
 
-    QVariantList tagsVariant = map.value("tags").toList();
     TagRef::List tags;
-    foreach (const QVariant &tag, tagsVariant) {
-        if (!tag.toString().isEmpty())
-            tags << TagRef(this, tag.toString(), storage());
+    foreach (const QString &tag, record.tags) {
+        if (!tag.isEmpty())
+            tags << TagRef(this, tag, storage());
     }
 
     setTagList(tags);
@@ -424,17 +526,19 @@ void Task::fromJson(const QVariantMap &map)
 
 SortedTaskContextMenuModel *Task::sortedContextMenuModel() const
 {
+    createMenuModels();
     return m_sortedContextMenuModel;
 }
 
 TaskContextMenuModel *Task::contextMenuModel() const
 {
+    createMenuModels();
     return m_contextMenuModel;
 }
 
 bool Task::operator==(const Task &other) const
 {
-    return m_uuid == other.uuid();
+    return hasSameUuid(other);
 }
 
 Kernel *Task::kernel() const
@@ -450,6 +554,7 @@ void Task::setKernel(Kernel *kernel)
     for (int i = 0; i < m_tags.count(); ++i) {
         TagRef tagRef(this, m_tags.at(i).tagName(), m_kernel->storage());
         m_tags.replace(i, tagRef); // operator[] is private
+        tagRef.incrementCount(); // Without storage it wasn't counted
     }
 
     modelSetup();
@@ -481,7 +586,7 @@ bool Task::equals(Task *other) const
 
 void Task::onEdited()
 {
-    m_modificationDate = QDateTime::currentDateTimeUtc();
+    m_modificationTimestamp = QDateTime::currentMSecsSinceEpoch();
     m_revision++;
     emit changed();
 }
@@ -489,7 +594,7 @@ void Task::onEdited()
 void Task::onDayChanged()
 {
     if (m_dueDate.isValid()) {
-        emit dueDateChanged();
+        emit dueStatusChanged();
         if (dueToday() || isOverdue())
             setStaged(true);
     }
@@ -497,18 +602,18 @@ void Task::onDayChanged()
 
 int Task::daysSinceCreation() const
 {
-    if (!m_creationDate.isValid())
+    if (m_creationTimestamp == NoTimestamp)
         return -1;
 
-    return m_creationDate.toLocalTime().date().daysTo(QDate::currentDate());
+    return creationDate().toLocalTime().date().daysTo(QDate::currentDate());
 }
 
 int Task::daysSinceLastPomodoro() const
 {
-    if (!m_lastPomodoroDate.isValid())
+    if (m_lastPomodoroTimestamp == NoTimestamp)
         return -1;
 
-    return m_lastPomodoroDate.toLocalTime().date().daysTo(QDate::currentDate());
+    return lastPomodoroDate().toLocalTime().date().daysTo(QDate::currentDate());
 }
 
 QString Task::dueDateString() const
@@ -557,6 +662,7 @@ void Task::setPriority(Priority priority)
 {
     if (priority != m_priority) {
         m_priority = priority;
+        updateSortKey();
         emit priorityChanged();
     }
 }
@@ -566,6 +672,21 @@ Task::Priority Task::priority() const
     return m_priority;
 }
 
+quint64 Task::sortKey() const
+{
+    return m_sortKey;
+}
+
+void Task::updateSortKey()
+{
+    // 5 bits of priority, no priority goes after the others but before low priority.
+    // Then 59 bits of creation time, inverted because newer tasks go first.
+    const int priority = m_priority == PriorityNone ? 9 : qBound(0, int(m_priority), 31);
+    const qint64 timeLimit = Q_INT64_C(1) << 58; // Milliseconds on each side of the epoch
+    const qint64 msecs = qBound(-timeLimit, m_creationTimestamp, timeLimit - 1);
+    m_sortKey = (quint64(priority) << 59) | quint64(timeLimit - 1 - msecs);
+}
+
 QString Task::priorityStr() const
 {
     if (m_priority == PriorityHigh) {
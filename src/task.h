@@ -54,9 +54,9 @@ class Task : public QObject, public Syncable {
     Q_OBJECT
     Q_PROPERTY(QString priorityStr READ priorityStr NOTIFY priorityChanged)
     Q_PROPERTY(Priority priority READ priority WRITE setPriority NOTIFY priorityChanged)
-    Q_PROPERTY(bool dueToday READ dueToday NOTIFY dueDateChanged)
-    Q_PROPERTY(bool isOverdue READ isOverdue NOTIFY dueDateChanged)
-    Q_PROPERTY(QString prettyDueDateString READ prettyDueDateString NOTIFY dueDateChanged)
+    Q_PROPERTY(bool dueToday READ dueToday NOTIFY dueStatusChanged)
+    Q_PROPERTY(bool isOverdue READ isOverdue NOTIFY dueStatusChanged)
+    Q_PROPERTY(QString prettyDueDateString READ prettyDueDateString NOTIFY dueStatusChanged)
     Q_PROPERTY(QString dueDateString READ dueDateString NOTIFY dueDateChanged)
     Q_PROPERTY(QDate dueDate READ dueDate WRITE setDueDate NOTIFY dueDateChanged)
     Q_PROPERTY(int daysSinceLastPomodoro READ daysSinceLastPomodoro NOTIFY daysSinceLastPomodoroChanged)
@@ -65,14 +65,14 @@ class Task : public QObject, public Syncable {
     Q_PROPERTY(QString summary READ summary WRITE setSummary NOTIFY summaryChanged)
     Q_PROPERTY(QString description READ description WRITE setDescription NOTIFY descriptionChanged)
     Q_PROPERTY(QObject * tagModel READ tagModel CONSTANT)
-    Q_PROPERTY(QObject * checkableTagModel READ checkableTagModel CONSTANT)
+    Q_PROPERTY(QObject * checkableTagModel READ checkableTagModel NOTIFY menuModelsChanged)
     // Shortcuts
     Q_PROPERTY(bool paused  READ paused  NOTIFY statusChanged STORED false)
     Q_PROPERTY(bool stopped READ stopped NOTIFY statusChanged STORED false)
     Q_PROPERTY(bool running READ running NOTIFY statusChanged STORED false)
 
-    Q_PROPERTY(TaskContextMenuModel* contextMenuModel READ contextMenuModel CONSTANT)
-    Q_PROPERTY(SortedTaskContextMenuModel* sortedContextMenuModel READ sortedContextMenuModel CONSTANT)
+    Q_PROPERTY(TaskContextMenuModel* contextMenuModel READ contextMenuModel NOTIFY menuModelsChanged)
+    Q_PROPERTY(SortedTaskContextMenuModel* sortedContextMenuModel READ sortedContextMenuModel NOTIFY menuModelsChanged)
 public:
     typedef QSharedPointer<Task> Ptr;
     typedef GenericListModel<Ptr> List;
@@ -102,7 +102,7 @@ public:
 
     bool containsTag(const QString &name) const;
     int indexOfTag(const QString &name) const;
-    TagRef::List tags() const;
+    const QList<TagRef> &tags() const;
     void setTagList(const TagRef::List &);
     QAbstractItemModel *tagModel() const;
     QAbstractItemModel *checkableTagModel() const;
@@ -131,8 +131,15 @@ public:
 
     QVariantMap toJson() const Q_DECL_OVERRIDE;
     void fromJson(const QVariantMap &) Q_DECL_OVERRIDE;
+    void fromRecord(const TaskRecord &);
+    TaskRecord toRecord() const;
+    static TaskRecord recordFromJson(const QVariantMap &); // thread-safe
+    static QVariantMap recordToJson(const TaskRecord &); // Used by toJson(), thread-safe
 
     TaskContextMenuModel *contextMenuModel() const;
+    // The menu models are created on first access. Call when the context menu closes.
+    void releaseMenuModels();
+    bool hasMenuModels() const;
     SortedTaskContextMenuModel *sortedContextMenuModel() const;
 
     bool operator==(const Task &other) const;
@@ -154,9 +161,12 @@ public:
 
     bool isOverdue() const;
     bool dueToday() const;
+    void onDayChanged(); // Called by Storage when the day changes and this task is due soon
 
     void setPriority(Priority);
     Priority priority() const;
+    // Priority and creation date packed so that a smaller key sorts first. Ties are broken by summary.
+    quint64 sortKey() const;
 
     QString priorityStr() const;
 
@@ -173,32 +183,34 @@ Q_SIGNALS:
     void changed();
     void tagToggled(const QString &tag);
     void dueDateChanged();
+    void dueStatusChanged(); // The due date or the current day changed
+    void menuModelsChanged(); // Created or released
 
 private Q_SLOTS:
     void onEdited();
-    void onDayChanged();
 
 private:
     explicit Task(Kernel *kernel, const QString &name = QString());
     void modelSetup();
-    void setModificationDate(const QDateTime &);
-    void setCreationDate(const QDateTime &);
+    void createMenuModels() const;
+    void updateSortKey();
 
     QString m_summary;
     QString m_description;
     TagRef::List m_tags;
-    CheckableTagModel *m_checkableTagModel;
+    mutable CheckableTagModel *m_checkableTagModel;
     TaskStatus m_status;
     bool m_staged;
     QWeakPointer<Task> m_this;
-    QDateTime m_creationDate;
-    QDateTime m_modificationDate;
-    QDateTime m_lastPomodoroDate;
+    qint64 m_creationTimestamp; // msecs since epoch, a QDateTime is only created when asked for
+    qint64 m_modificationTimestamp;
+    qint64 m_lastPomodoroTimestamp;
     QDate m_dueDate;
-    TaskContextMenuModel *m_contextMenuModel;
-    SortedTaskContextMenuModel *m_sortedContextMenuModel;
+    mutable TaskContextMenuModel *m_contextMenuModel;
+    mutable SortedTaskContextMenuModel *m_sortedContextMenuModel;
     Kernel *m_kernel;
     Priority m_priority;
+    quint64 m_sortKey;
 };
 
 inline QDebug operator<<(QDebug dbg, const Task::Ptr &task)
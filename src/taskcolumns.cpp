@@ -0,0 +1,104 @@
+/*
+  This file is part of Flow.
+
+  Copyright (C) 2015 Sérgio Martins <iamsergio@gmail.com>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "taskcolumns.h"
+
+int TaskColumns::count() const
+{
+    return m_flags.count();
+}
+
+quint8 TaskColumns::flags(int row) const
+{
+    return m_flags.at(row);
+}
+
+bool TaskColumns::matches(int row, quint8 mask, quint8 value) const
+{
+    return (m_flags.at(row) & mask) == value;
+}
+
+qint32 TaskColumns::dueDay(int row) const
+{
+    return m_dueDays.at(row);
+}
+
+qint8 TaskColumns::priority(int row) const
+{
+    return m_priorities.at(row);
+}
+
+void TaskColumns::reset(const QList<Task::Ptr> &tasks)
+{
+    m_flags.resize(tasks.count());
+    m_dueDays.resize(tasks.count());
+    m_priorities.resize(tasks.count());
+    for (int i = 0; i < tasks.count(); ++i)
+        setRow(i, tasks.at(i).data());
+}
+
+void TaskColumns::insertRows(const QList<Task::Ptr> &tasks, int first, int last)
+{
+    const int numRows = last - first + 1;
+    if (first == m_flags.count()) { // Appending, the common case
+        m_flags.resize(m_flags.count() + numRows);
+        m_dueDays.resize(m_dueDays.count() + numRows);
+        m_priorities.resize(m_priorities.count() + numRows);
+    } else {
+        m_flags.insert(first, numRows, 0);
+        m_dueDays.insert(first, numRows, 0);
+        m_priorities.insert(first, numRows, 0);
+    }
+
+    for (int i = first; i <= last; ++i)
+        setRow(i, tasks.at(i).data());
+}
+
+void TaskColumns::removeRows(int first, int last)
+{
+    const int numRows = last - first + 1;
+    m_flags.remove(first, numRows);
+    m_dueDays.remove(first, numRows);
+    m_priorities.remove(first, numRows);
+}
+
+void TaskColumns::updateRows(const QList<Task::Ptr> &tasks, int first, int last)
+{
+    for (int i = first; i <= last; ++i)
+        setRow(i, tasks.at(i).data());
+}
+
+void TaskColumns::setRow(int row, const Task *task)
+{
+    quint8 flags = 0;
+    if (task->staged())
+        flags |= StagedFlag;
+    if (task->status() == TaskStarted)
+        flags |= RunningFlag;
+    if (!task->tags().isEmpty())
+        flags |= TaggedFlag;
+
+    const QDate dueDate = task->dueDate();
+    if (dueDate.isValid())
+        flags |= DueDateFlag;
+
+    m_flags[row] = flags;
+    m_dueDays[row] = dueDate.isValid() ? qint32(dueDate.toJulianDay()) : 0;
+    m_priorities[row] = qint8(task->priority());
+}
@@ -0,0 +1,59 @@
+/*
+  This file is part of Flow.
+
+  Copyright (C) 2015 Sérgio Martins <iamsergio@gmail.com>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FLOW_TASKCOLUMNS_H
+#define FLOW_TASKCOLUMNS_H
+
+#include "task.h"
+
+#include <QVector>
+
+// The fields the task filters and sorting read, copied into contiguous arrays with one entry per
+// row of Storage's task list. Proxies scan these instead of dereferencing every Task.
+// Kept in sync by Storage, from the task list's model signals.
+class TaskColumns
+{
+public:
+    enum Flag {
+        StagedFlag = 0x1,
+        RunningFlag = 0x2,
+        TaggedFlag = 0x4,
+        DueDateFlag = 0x8
+    };
+
+    int count() const;
+    quint8 flags(int row) const;
+    // True if the row's flags selected by mask are equal to value
+    bool matches(int row, quint8 mask, quint8 value) const;
+    qint32 dueDay(int row) const; // Julian day, 0 if there's no due date
+    qint8 priority(int row) const;
+
+    void reset(const QList<Task::Ptr> &tasks);
+    void insertRows(const QList<Task::Ptr> &tasks, int first, int last);
+    void removeRows(int first, int last);
+    void updateRows(const QList<Task::Ptr> &tasks, int first, int last);
+
+private:
+    void setRow(int row, const Task *task);
+    QVector<quint8> m_flags;
+    QVector<qint32> m_dueDays;
+    QVector<qint8> m_priorities;
+};
+
+#endif
@@ -21,9 +21,10 @@
 #include "task.h"
 #include "checkabletagmodel.h"
 
-TaskContextMenuModel::TaskContextMenuModel(Task *task, QObject *parent)
+TaskContextMenuModel::TaskContextMenuModel(Task *task, CheckableTagModel *tagModel, QObject *parent)
     : QAbstractListModel(parent)
     , m_task(task)
+    , m_tagModel(tagModel)
     , m_tagOnlyMenu(false)
 {
     setObjectName("TaskContextMenuModel");
@@ -56,21 +57,20 @@ TaskContextMenuModel::TaskContextMenuModel(Task *task, QObject *parent)
     connect(this, &TaskContextMenuModel::modelReset, this, &TaskContextMenuModel::countChanged);
     connect(this, &TaskContextMenuModel::layoutChanged, this, &TaskContextMenuModel::countChanged);
 
-    QAbstractItemModel *tagModel = m_task->checkableTagModel();
-    connect(tagModel, &QAbstractItemModel::rowsInserted, this, &TaskContextMenuModel::onRowsInserted);
-    connect(tagModel, &QAbstractItemModel::rowsAboutToBeInserted, this, &TaskContextMenuModel::onRowsAboutToBeInserted);
-    connect(tagModel, &QAbstractItemModel::rowsRemoved, this, &TaskContextMenuModel::onRowsRemoved);
-    connect(tagModel, &QAbstractItemModel::rowsAboutToBeRemoved, this, &TaskContextMenuModel::onRowsAboutToBeRemoved);
-    connect(tagModel, &QAbstractItemModel::modelReset, this, &TaskContextMenuModel::onModelReset);
-    connect(tagModel, &QAbstractItemModel::modelAboutToBeReset, this, &TaskContextMenuModel::onModelAboutToBeReset);
-    connect(tagModel, &QAbstractItemModel::layoutChanged, this, &TaskContextMenuModel::onLayoutChanged);
-    connect(tagModel, &QAbstractItemModel::layoutAboutToBeChanged, this, &TaskContextMenuModel::onLayoutAboutToChange);
-    connect(tagModel, &QAbstractItemModel::dataChanged, this, &TaskContextMenuModel::onDataChanged);
+    connect(m_tagModel, &QAbstractItemModel::rowsInserted, this, &TaskContextMenuModel::onRowsInserted);
+    connect(m_tagModel, &QAbstractItemModel::rowsAboutToBeInserted, this, &TaskContextMenuModel::onRowsAboutToBeInserted);
+    connect(m_tagModel, &QAbstractItemModel::rowsRemoved, this, &TaskContextMenuModel::onRowsRemoved);
+    connect(m_tagModel, &QAbstractItemModel::rowsAboutToBeRemoved, this, &TaskContextMenuModel::onRowsAboutToBeRemoved);
+    connect(m_tagModel, &QAbstractItemModel::modelReset, this, &TaskContextMenuModel::onModelReset);
+    connect(m_tagModel, &QAbstractItemModel::modelAboutToBeReset, this, &TaskContextMenuModel::onModelAboutToBeReset);
+    connect(m_tagModel, &QAbstractItemModel::layoutChanged, this, &TaskContextMenuModel::onLayoutChanged);
+    connect(m_tagModel, &QAbstractItemModel::layoutAboutToBeChanged, this, &TaskContextMenuModel::onLayoutAboutToChange);
+    connect(m_tagModel, &QAbstractItemModel::dataChanged, this, &TaskContextMenuModel::onDataChanged);
 }
 
 int TaskContextMenuModel::rowCount(const QModelIndex &/*parent*/) const
 {
-    return rowOffset() + m_task->checkableTagModel()->rowCount(QModelIndex());
+    return rowOffset() + m_tagModel->rowCount(QModelIndex());
 }
 
 QVariant TaskContextMenuModel::staticData(OptionType optionType, int role) const
@@ -107,13 +107,12 @@ QVariant TaskContextMenuModel::data(const QModelIndex &index, int role) const
         return staticData(static_cast<OptionType>(index.row()), role);
 
     const int tagRow = index.row() - rowOffset();
-    QAbstractItemModel *tagModel = m_task->checkableTagModel();
-    if (tagRow < 0 || tagRow >= tagModel->rowCount()) {
+    if (tagRow < 0 || tagRow >= m_tagModel->rowCount()) {
         qWarning() << "TaskContextMenuModel: invalid index" << tagRow;
         return QVariant();
     }
 
-    QModelIndex tagIndex = tagModel->index(tagRow, 0);
+    QModelIndex tagIndex = m_tagModel->index(tagRow, 0);
 
     switch (role) {
     case TextRole:
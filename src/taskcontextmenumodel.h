@@ -24,6 +24,7 @@
 #include <QHash>
 
 class Task;
+class CheckableTagModel;
 
 class TaskContextMenuModel : public QAbstractListModel
 {
@@ -54,7 +55,7 @@ public:
         bool dismiss;
     };
 
-    explicit TaskContextMenuModel(Task *task, QObject *parent = 0);
+    TaskContextMenuModel(Task *task, CheckableTagModel *tagModel, QObject *parent = 0);
     int rowCount(const QModelIndex &parent) const Q_DECL_OVERRIDE;
     QVariant data(const QModelIndex &index, int role) const Q_DECL_OVERRIDE;
     QHash<int, QByteArray> roleNames() const Q_DECL_OVERRIDE;
@@ -83,6 +84,7 @@ private:
     int rowOffset() const;
     QVariant staticData(OptionType row, int role) const;
     Task *m_task;
+    CheckableTagModel *m_tagModel;
     QHash<OptionType, Option> m_staticOptions;
     Option m_moveToTodayOption;
     Option m_archiveOption;
@@ -19,11 +19,18 @@
 
 #include "taskfilterproxymodel.h"
 #include "storage.h"
+#include "taskcolumns.h"
 
 #include <QDebug>
 
 TaskFilterProxyModel::TaskFilterProxyModel(QObject *parent)
     : QSortFilterProxyModel(parent)
+    , m_sourceTasks(Q_NULLPTR)
+    , m_sourceTaggedTasks(Q_NULLPTR)
+    , m_sourceProxy(Q_NULLPTR)
+    , m_columns(Q_NULLPTR)
+    , m_flagMask(0)
+    , m_flagValue(0)
     , m_filterUntagged(false)
     , m_previousCount(0)
     , m_filterDueDated(false)
@@ -39,6 +46,7 @@ TaskFilterProxyModel::TaskFilterProxyModel(QObject *parent)
     connect(this, &TaskFilterProxyModel::layoutChanged,
             this, &TaskFilterProxyModel::onSourceCountChanged);
 
+    updateFlagFilter();
     sort(0);
 }
 
@@ -58,15 +66,11 @@ bool TaskFilterProxyModel::filterAcceptsRow(int source_row, const QModelIndex &s
         return false;
     }
 
-    QModelIndex index = sourceModel()->index(source_row, 0);
-    if (!index.isValid())
-        return false;
-
-    QVariant v = index.data(Storage::TaskPtrRole);
-    if (!v.isValid())
-        return false;
+    const int row = columnRow(source_row);
+    if (row != -1)
+        return m_columns->matches(row, m_flagMask, m_flagValue);
 
-    Task::Ptr task = v.value<Task::Ptr>();
+    const Task *task = taskAtSourceRow(source_row);
     if (!task)
         return false;
 
@@ -85,24 +89,24 @@ bool TaskFilterProxyModel::filterAcceptsRow(int source_row, const QModelIndex &s
     if (m_filterDueDated)
         return task->dueDate().isValid();
 
-    if (m_tagText.isEmpty())
-        return true;
-
-    TagRef::List tags = task->tags();
-    for (int i = 0; i < tags.count(); ++i) {
-        const TagRef &tagref = tags.at(i);
-        if (tagref.tagName() == m_tagText)
-            return true;
-    }
-
-    return false;
+    return true;
 }
 
 bool TaskFilterProxyModel::lessThan(const QModelIndex &left, const QModelIndex &right) const
 {
-    Task::Ptr leftTask = left.data(Storage::TaskPtrRole).value<Task::Ptr>();
-    Task::Ptr rightTask = right.data(Storage::TaskPtrRole).value<Task::Ptr>();
+    const Task *leftTask = taskAtSourceRow(left.row());
+    const Task *rightTask = taskAtSourceRow(right.row());
     if (m_filterDueDated) {
+        const int leftRow = columnRow(left.row());
+        const int rightRow = columnRow(right.row());
+        if (leftRow != -1 && rightRow != -1) {
+            const qint32 leftDueDay = m_columns->dueDay(leftRow);
+            const qint32 rightDueDay = m_columns->dueDay(rightRow);
+            if (leftDueDay != rightDueDay)
+                return leftDueDay < rightDueDay;
+            return defaultLessThan(leftTask, rightTask);
+        }
+
         if (leftTask->dueDate() == rightTask->dueDate()) {
             return defaultLessThan(leftTask, rightTask);
         } else {
@@ -113,18 +117,11 @@ bool TaskFilterProxyModel::lessThan(const QModelIndex &left, const QModelIndex &
     }
 }
 
-void TaskFilterProxyModel::setTagName(const QString &tagText)
-{
-    if (m_tagText != tagText) {
-        m_tagText = tagText;
-        invalidateFilter();
-    }
-}
-
 void TaskFilterProxyModel::setFilterUntagged(bool filter)
 {
     if (m_filterUntagged != filter) {
         m_filterUntagged = filter;
+        updateFlagFilter();
         invalidateFilter();
     }
 }
@@ -133,6 +130,7 @@ void TaskFilterProxyModel::setFilterDueDated(bool filter)
 {
     if (m_filterDueDated != filter) {
         m_filterDueDated = filter;
+        updateFlagFilter();
         invalidateFilter();
     }
 }
@@ -141,6 +139,7 @@ void TaskFilterProxyModel::setFilterArchived(bool filter)
 {
     if (filter != m_filterArchived) {
         m_filterArchived = filter;
+        updateFlagFilter();
         if (filter)
             setFilterStaged(false);
         invalidateFilter();
@@ -151,6 +150,7 @@ void TaskFilterProxyModel::setFilterStaged(bool filter)
 {
     if (filter != m_filterStaged) {
         m_filterStaged = filter;
+        updateFlagFilter();
         if (filter)
             setFilterArchived(false);
         invalidateFilter();
@@ -165,28 +165,94 @@ void TaskFilterProxyModel::invalidateFilter()
 
 void TaskFilterProxyModel::setSourceModel(QAbstractItemModel *sourceModel)
 {
+    // Set before the base class filters and sorts
+    m_sourceTasks = Task::List::fromModel(sourceModel);
+    m_sourceTaggedTasks = GenericListModel<Task*>::fromModel(sourceModel);
+    m_sourceProxy = qobject_cast<TaskFilterProxyModel*>(sourceModel);
+
     QSortFilterProxyModel::setSourceModel(sourceModel);
     m_previousCount = rowCount();
 }
 
+void TaskFilterProxyModel::setTaskColumns(const TaskColumns *columns)
+{
+    if (m_columns != columns) {
+        m_columns = columns;
+        invalidateFilter();
+    }
+}
+
+int TaskFilterProxyModel::columnRow(int sourceRow) const
+{
+    if (!m_columns)
+        return -1;
+
+    int row = -1;
+    if (m_sourceTasks) {
+        row = sourceRow;
+    } else if (m_sourceProxy && m_sourceProxy->m_columns == m_columns) {
+        const QModelIndex index = m_sourceProxy->mapToSource(m_sourceProxy->index(sourceRow, 0));
+        row = index.isValid() ? m_sourceProxy->columnRow(index.row()) : -1;
+    }
+
+    return row < m_columns->count() ? row : -1;
+}
+
+void TaskFilterProxyModel::updateFlagFilter()
+{
+    // Same as the Task based checks in filterAcceptsRow()
+    m_flagMask = TaskColumns::RunningFlag;
+    m_flagValue = 0;
+
+    if (m_filterArchived) {
+        m_flagMask |= TaskColumns::StagedFlag;
+    } else if (m_filterStaged) {
+        m_flagMask |= TaskColumns::StagedFlag;
+        m_flagValue |= TaskColumns::StagedFlag;
+    }
+
+    if (m_filterUntagged) {
+        m_flagMask |= TaskColumns::TaggedFlag;
+    } else if (m_filterDueDated) {
+        m_flagMask |= TaskColumns::DueDateFlag;
+        m_flagValue |= TaskColumns::DueDateFlag;
+    }
+}
+
+Task *TaskFilterProxyModel::taskAtSourceRow(int sourceRow) const
+{
+    if (m_sourceTasks)
+        return m_sourceTasks->at(sourceRow).data();
+
+    if (m_sourceTaggedTasks)
+        return m_sourceTaggedTasks->at(sourceRow);
+
+    if (m_sourceProxy)
+        return m_sourceProxy->taskAt(sourceRow);
+
+    // Some other model, go through the role
+    QAbstractItemModel *source = sourceModel();
+    return source ? source->index(sourceRow, 0).data(Storage::TaskRole).value<Task*>() : Q_NULLPTR;
+}
+
+Task *TaskFilterProxyModel::taskAt(int proxyRow) const
+{
+    const QModelIndex sourceIndex = mapToSource(index(proxyRow, 0));
+    return sourceIndex.isValid() ? taskAtSourceRow(sourceIndex.row()) : Q_NULLPTR;
+}
+
 void TaskFilterProxyModel::onSourceCountChanged()
 {
     emit countChanged(rowCount(), m_previousCount);
     m_previousCount = rowCount();
 }
 
-bool TaskFilterProxyModel::defaultLessThan(const Task::Ptr &leftTask, const Task::Ptr &rightTask) const
+bool TaskFilterProxyModel::defaultLessThan(const Task *leftTask, const Task *rightTask) const
 {
-    const int leftPriority = leftTask->priority() == Task::PriorityNone ? 9 : leftTask->priority();
-    const int rightPriority = rightTask->priority() == Task::PriorityNone ? 9 : rightTask->priority();
+    const quint64 leftKey = leftTask->sortKey();
+    const quint64 rightKey = rightTask->sortKey();
+    if (leftKey != rightKey)
+        return leftKey < rightKey; // Priority, then newest first
 
-    if (leftPriority == rightPriority) {
-        if (leftTask->creationDate() == rightTask->creationDate()) {
-            return leftTask->summary() < rightTask->summary();
-        } else {
-            return leftTask->creationDate() > rightTask->creationDate();
-        }
-    } else {
-        return leftPriority < rightPriority;
-    }
+    return leftTask->summary() < rightTask->summary();
 }
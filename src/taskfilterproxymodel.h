@@ -23,6 +23,8 @@
 #include "task.h"
 #include <QSortFilterProxyModel>
 
+class TaskColumns;
+
 class TaskFilterProxyModel : public QSortFilterProxyModel
 {
     Q_OBJECT
@@ -33,13 +35,18 @@ public:
     int count() const;
     bool filterAcceptsRow(int source_row, const QModelIndex &source_parent) const Q_DECL_OVERRIDE;
     bool lessThan(const QModelIndex &left, const QModelIndex &right) const Q_DECL_OVERRIDE;
-    void setTagName(const QString &);
     void setFilterUntagged(bool filter);
     void setFilterDueDated(bool filter);
     void setFilterArchived(bool filter);
     void setFilterStaged(bool filter);
     void invalidateFilter();
     void setSourceModel(QAbstractItemModel *sourceModel) Q_DECL_OVERRIDE;
+    // Storage's columns, used when the source is its task list or another proxy using them
+    void setTaskColumns(const TaskColumns *columns);
+
+    // Typed access to the source's task, without going through QVariant
+    Task *taskAtSourceRow(int sourceRow) const;
+    Task *taskAt(int proxyRow) const;
 
 Q_SIGNALS:
     void countChanged(int count, int previousCount);
@@ -47,8 +54,15 @@ private Q_SLOTS:
     void onSourceCountChanged();
 
 private:
-    bool defaultLessThan(const Task::Ptr &leftTask, const Task::Ptr &rightTask) const;
-    QString m_tagText;
+    bool defaultLessThan(const Task *leftTask, const Task *rightTask) const;
+    int columnRow(int sourceRow) const;
+    void updateFlagFilter();
+    const Task::List *m_sourceTasks;
+    const GenericListModel<Task*> *m_sourceTaggedTasks; // Tag::taskModel()
+    const TaskFilterProxyModel *m_sourceProxy;
+    const TaskColumns *m_columns;
+    quint8 m_flagMask; // What filterAcceptsRow() checks, as column flags
+    quint8 m_flagValue;
     bool m_filterUntagged;
     int m_previousCount;
     bool m_filterDueDated;
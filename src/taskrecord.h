@@ -0,0 +1,76 @@
+/*
+  This file is part of Flow.
+
+  Copyright (C) 2015 Sérgio Martins <iamsergio@gmail.com>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FLOW_TASKRECORD_H
+#define FLOW_TASKRECORD_H
+
+#include <QString>
+#include <QStringList>
+
+#include <limits>
+
+// Plain values of a serialized task or tag. Filled by the loaders without going through
+// QVariantMap. Defaults are the same ones Task::fromJson() and Tag::fromJson() use for missing keys.
+
+struct TagRecord
+{
+    TagRecord()
+        : revision(0)
+        , revisionOnWebDAVServer(-1)
+    {}
+
+    QString uuid;
+    int revision;
+    int revisionOnWebDAVServer;
+    QString name;
+};
+
+struct TaskRecord
+{
+    // A timestamp the task never had, which isn't serialized. Missing ones load as 0, as they always did.
+    static const qint64 NoTimestamp = std::numeric_limits<qint64>::min();
+
+    TaskRecord()
+        : revision(0)
+        , revisionOnWebDAVServer(-1)
+        , staged(false)
+        , priority(0)
+        , creationTimestamp(0)
+        , modificationTimestamp(0)
+        , lastPomodoroTimestamp(0)
+        , hasDueDate(false)
+        , dueDate(0)
+    {}
+
+    QString uuid;
+    int revision;
+    int revisionOnWebDAVServer;
+    QString summary;
+    QString description;
+    bool staged;
+    int priority;
+    qint64 creationTimestamp; // msecs since epoch
+    qint64 modificationTimestamp;
+    qint64 lastPomodoroTimestamp;
+    bool hasDueDate;
+    qint64 dueDate; // julian day
+    QStringList tags;
+};
+
+#endif
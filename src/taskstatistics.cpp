@@ -0,0 +1,165 @@
+/*
+  This file is part of Flow.
+
+  Copyright (C) 2015 Sérgio Martins <iamsergio@gmail.com>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "taskstatistics.h"
+#include "task.h"
+
+#include <QDate>
+
+TaskStatistics::TaskStatistics(QObject *parent)
+    : QObject(parent)
+    , m_today(QDate::currentDate().toJulianDay())
+    , m_creationDaySum(0)
+    , m_datedCount(0)
+    , m_undatedCount(0)
+    , m_stagedCount(0)
+    , m_overdueCount(0)
+{
+}
+
+int TaskStatistics::taskCount() const
+{
+    return m_entries.count();
+}
+
+int TaskStatistics::stagedCount() const
+{
+    return m_stagedCount;
+}
+
+int TaskStatistics::archivedCount() const
+{
+    return m_entries.count() - m_stagedCount;
+}
+
+int TaskStatistics::overdueCount() const
+{
+    return m_overdueCount;
+}
+
+int TaskStatistics::ageAverage() const
+{
+    if (m_entries.isEmpty())
+        return 0;
+
+    // Same as averaging Task::daysSinceCreation(), which is -1 for tasks without creation date
+    const qint64 totalAge = m_datedCount * m_today - m_creationDaySum - m_undatedCount;
+    return totalAge / m_entries.count();
+}
+
+void TaskStatistics::addTasks(const QList<Task*> &tasks)
+{
+    bool added = false;
+    foreach (Task *task, tasks) {
+        if (m_entries.contains(task))
+            continue;
+
+        const Entry entry = entryFor(task);
+        m_entries.insert(task, entry);
+        account(entry, 1);
+        added = true;
+    }
+
+    if (added)
+        emit changed();
+}
+
+void TaskStatistics::removeTask(Task *task)
+{
+    QHash<const Task*, Entry>::iterator it = m_entries.find(task);
+    if (it == m_entries.end())
+        return;
+
+    account(it.value(), -1);
+    m_entries.erase(it);
+    emit changed();
+}
+
+void TaskStatistics::updateTask(Task *task)
+{
+    QHash<const Task*, Entry>::iterator it = m_entries.find(task);
+    if (it == m_entries.end())
+        return;
+
+    const Entry entry = entryFor(task);
+    const Entry old = it.value();
+    if (entry.creationDay == old.creationDay && entry.dueDay == old.dueDay && entry.staged == old.staged)
+        return;
+
+    account(old, -1);
+    account(entry, 1);
+    it.value() = entry;
+    emit changed();
+}
+
+void TaskStatistics::clear()
+{
+    if (m_entries.isEmpty())
+        return;
+
+    m_entries.clear();
+    m_creationDaySum = 0;
+    m_datedCount = 0;
+    m_undatedCount = 0;
+    m_stagedCount = 0;
+    m_overdueCount = 0;
+    emit changed();
+}
+
+void TaskStatistics::setToday(qint64 julianDay)
+{
+    if (julianDay == m_today)
+        return;
+
+    // Once a day, so it's fine to recount
+    m_today = julianDay;
+    m_overdueCount = 0;
+    foreach (const Entry &entry, m_entries) {
+        if (entry.dueDay != 0 && entry.dueDay < m_today)
+            m_overdueCount++;
+    }
+
+    emit changed();
+}
+
+TaskStatistics::Entry TaskStatistics::entryFor(const Task *task) const
+{
+    Entry entry;
+    const QDateTime creationDate = task->creationDate();
+    entry.creationDay = creationDate.isValid() ? creationDate.toLocalTime().date().toJulianDay() : 0;
+    entry.dueDay = task->dueDate().isValid() ? task->dueDate().toJulianDay() : 0;
+    entry.staged = task->staged();
+    return entry;
+}
+
+void TaskStatistics::account(const Entry &entry, int sign)
+{
+    if (entry.creationDay != 0) {
+        m_creationDaySum += sign * entry.creationDay;
+        m_datedCount += sign;
+    } else {
+        m_undatedCount += sign;
+    }
+
+    if (entry.staged)
+        m_stagedCount += sign;
+
+    if (entry.dueDay != 0 && entry.dueDay < m_today)
+        m_overdueCount += sign;
+}
@@ -0,0 +1,73 @@
+/*
+  This file is part of Flow.
+
+  Copyright (C) 2015 Sérgio Martins <iamsergio@gmail.com>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FLOW_TASKSTATISTICS_H
+#define FLOW_TASKSTATISTICS_H
+
+#include <QObject>
+#include <QHash>
+
+class Task;
+
+// Aggregates over the stored tasks, kept up to date by Storage as tasks are added,
+// removed and changed, so reading them is O(1). Per tag counts are in Tag::taskCount().
+class TaskStatistics : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(int taskCount READ taskCount NOTIFY changed)
+    Q_PROPERTY(int stagedCount READ stagedCount NOTIFY changed)
+    Q_PROPERTY(int archivedCount READ archivedCount NOTIFY changed)
+    Q_PROPERTY(int overdueCount READ overdueCount NOTIFY changed)
+    Q_PROPERTY(int ageAverage READ ageAverage NOTIFY changed)
+public:
+    explicit TaskStatistics(QObject *parent = Q_NULLPTR);
+
+    int taskCount() const;
+    int stagedCount() const;
+    int archivedCount() const;
+    int overdueCount() const;
+    int ageAverage() const; // in days
+
+    void addTasks(const QList<Task*> &);
+    void removeTask(Task *);
+    void updateTask(Task *);
+    void clear();
+    void setToday(qint64 julianDay);
+
+Q_SIGNALS:
+    void changed();
+
+private:
+    struct Entry {
+        qint64 creationDay; // local Julian day, 0 if unknown
+        qint64 dueDay; // 0 if there's no due date
+        bool staged;
+    };
+    Entry entryFor(const Task *task) const;
+    void account(const Entry &entry, int sign);
+    QHash<const Task*, Entry> m_entries;
+    qint64 m_today;
+    qint64 m_creationDaySum;
+    int m_datedCount;
+    int m_undatedCount;
+    int m_stagedCount;
+    int m_overdueCount;
+};
+
+#endif
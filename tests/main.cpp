@@ -6,6 +6,7 @@
 #include "testtaskfiltermodel.h"
 #include "teststagedtasksmodel.h"
 #include "testarchivedtasksmodel.h"
+#include "testbenchmarks.h"
 #include "quick/testui.h"
 
 #ifndef NO_WEBDAV
@@ -82,6 +83,12 @@ int main(int argc, char *argv[])
         success &= QTest::qExec(&uiTest, argc, argv) == 0;
         Q_ASSERT(success);
     }
+    if (qEnvironmentVariableIsSet("FLOW_BENCHMARKS")) {
+        TestBenchmarks benchmarks;
+        success &= QTest::qExec(&benchmarks, argc, argv) == 0;
+        Q_ASSERT(success);
+    }
+
     if (success)
         qDebug() << "Success!";
     else
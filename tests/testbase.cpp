@@ -33,14 +33,17 @@
 #include "quickview.h"
 #include <QtTest/QtTest>
 #include <QQuickItem>
+#include <QTemporaryDir>
 
-TestBase::TestBase() : m_view(nullptr)
+TestBase::TestBase() : m_view(nullptr), m_tempDir(nullptr)
 {
     RuntimeConfiguration config;
     config.setDataFileName("data.dat");
     config.setPluginsSupported(false);
     config.setSettings(new Settings("unit-test-settings.ini"));
     config.setSaveEnabled(false);
+    config.setSaveQuietPeriod(0); // Tests count saves after a single event loop pass
+    config.setSaveMaxStaleness(0);
     config.setWebDAVFileName("unit-test-flow.dat");
     m_kernel = new Kernel(config, this);
     m_storage = m_kernel->storage();
@@ -57,11 +60,12 @@ TestBase::~TestBase()
 {
     QFile::remove("unit-test-settings.ini");
     delete m_view;
+    delete m_tempDir;
 }
 
 bool TestBase::checkStorageConsistency(int expectedTagCount)
 {
-    const Tag::List tags = m_storage->tags();
+    const QList<Tag::Ptr> &tags = m_storage->tags();
     expectedTagCount = expectedTagCount == -1 ? tags.count() : expectedTagCount;
 
     if (expectedTagCount != Tag::tagCount) {
@@ -124,6 +128,29 @@ void TestBase::createNewKernel(const QString &dataFilename, bool load)
         m_kernel->storage()->load();
 }
 
+RuntimeConfiguration TestBase::savingConfiguration(const QString &dataFilename)
+{
+    delete m_tempDir;
+    m_tempDir = new QTemporaryDir();
+    if (!m_tempDir->isValid())
+        qWarning() << "Could not create a temporary directory for" << dataFilename;
+
+    RuntimeConfiguration config;
+    config.setDataFileName(m_tempDir->path() + "/" + dataFilename);
+    config.setPluginsSupported(false);
+    config.setSaveEnabled(true);
+    return config;
+}
+
+Kernel *TestBase::createSessionKernel(RuntimeConfiguration config, bool load)
+{
+    config.setSettings(new Settings("unit-test-settings.ini"));
+    Kernel *kernel = new Kernel(config);
+    if (load)
+        kernel->storage()->load();
+    return kernel;
+}
+
 void TestBase::createInstanceWithUI()
 {
     createNewKernel("quick_tests.dat");
@@ -31,6 +31,8 @@ class Controller;
 class Settings;
 class QString;
 class QQuickItem;
+class QTemporaryDir;
+class RuntimeConfiguration;
 
 class TestBase : public QObject
 {
@@ -41,6 +43,11 @@ public:
 
     bool checkStorageConsistency(int expectedTagCount = -1);
     void createNewKernel(const QString &dataFilename, bool load = true);
+    // For tests that save: plugins off, saving on, and the data file in a new temporary
+    // directory, which lives until the next call. Tests set the options they're about.
+    RuntimeConfiguration savingConfiguration(const QString &dataFilename);
+    // One kernel per session, ending it saves. Each needs its own Settings, which it takes.
+    static Kernel *createSessionKernel(RuntimeConfiguration config, bool load = true);
     void createInstanceWithUI();
     void waitForIt();
     void stopWaiting();
@@ -56,6 +63,7 @@ protected:
     Storage *m_storage;
     Controller *m_controller;
     Settings *m_settings;
+    QTemporaryDir *m_tempDir;
 };
 
 #endif
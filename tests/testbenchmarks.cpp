@@ -0,0 +1,384 @@
+/*
+  This file is part of Flow.
+
+  Copyright (C) 2015 Sérgio Martins <iamsergio@gmail.com>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testbenchmarks.h"
+#include "jsonstorage.h"
+#include "binaryserializer.h"
+#include "kernel.h"
+#include "storage.h"
+#include "task.h"
+#include "settings.h"
+#include "runtimeconfiguration.h"
+#include "taskfilterproxymodel.h"
+
+#include <QAbstractProxyModel>
+#include <QFile>
+#include <QThread>
+#include <QUuid>
+
+#if defined(__GLIBC__)
+# include <malloc.h>
+#endif
+
+enum {
+    DefaultNumTasks = 100000,
+    ParallelLoadNumTasks = 200000,
+    NumTags = 50
+};
+
+// In kB, -1 if not supported on this platform
+static qint64 procStatusValue(const QByteArray &key)
+{
+    QFile file("/proc/self/status");
+    if (!file.open(QIODevice::ReadOnly))
+        return -1;
+
+    foreach (const QByteArray &line, file.readAll().split('\n')) {
+        if (line.startsWith(key + ':'))
+            return line.mid(key.size() + 1).trimmed().split(' ').first().toLongLong();
+    }
+
+    return -1;
+}
+
+static void resetPeakResidentSetSize()
+{
+#if defined(__GLIBC__)
+    malloc_trim(0); // Otherwise memory freed by a previous run gets reused and the peak looks smaller
+#endif
+    QFile file("/proc/self/clear_refs");
+    if (file.open(QIODevice::WriteOnly))
+        file.write("5");
+}
+
+static QByteArray syntheticJsonData(int numTasks, int numTags = NumTags)
+{
+    QByteArray data;
+    data.reserve(numTasks * 400);
+    data += "{\n    \"JsonSerializerVersion\": 1,\n";
+    data += "    \"instanceId\": \"" + QUuid::createUuid().toByteArray() + "\",\n";
+    data += "    \"tags\": [\n";
+    for (int i = 0; i < numTags; ++i) {
+        data += "        {\"name\": \"tag" + QByteArray::number(i) + "\", \"revision\": 0, "
+                "\"revisionOnWebDAVServer\": -1, \"uuid\": \"" + QUuid::createUuid().toByteArray() + "\"}";
+        data += i == numTags - 1 ? "\n" : ",\n";
+    }
+
+    data += "    ],\n    \"tasks\": [\n";
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    for (int i = 0; i < numTasks; ++i) {
+        data += "        {\"creationTimestamp\": " + QByteArray::number(now - i * 60000LL)
+                + ", \"description\": \"Some description for task " + QByteArray::number(i) + "\nwith two lines\""
+                + ", \"modificationTimestamp\": " + QByteArray::number(now - i * 1000LL)
+                + ", \"priority\": " + QByteArray::number(i % 3)
+                + ", \"revision\": " + QByteArray::number(i % 7)
+                + ", \"revisionOnWebDAVServer\": -1"
+                + ", \"staged\": " + (i % 10 == 0 ? "true" : "false")
+                + ", \"summary\": \"Task " + QByteArray::number(i) + "\""
+                + ", \"tags\": [\"tag" + QByteArray::number(i % numTags) + "\", \"tag" + QByteArray::number((i * 7) % numTags) + "\"]"
+                + ", \"uuid\": \"" + QUuid::createUuid().toByteArray() + "\"}";
+        data += i == numTasks - 1 ? "\n" : ",\n";
+    }
+
+    data += "    ]\n}\n";
+    return data;
+}
+
+// Reads every role of every row, like QML delegates do
+static int readAllRoles(QAbstractItemModel *model)
+{
+    const QList<int> roles = model->roleNames().keys();
+    const int rowCount = model->rowCount();
+    int numValid = 0;
+    for (int row = 0; row < rowCount; ++row) {
+        const QModelIndex index = model->index(row, 0);
+        foreach (int role, roles)
+            numValid += model->data(index, role).isValid() ? 1 : 0;
+    }
+
+    return numValid;
+}
+
+typedef Storage::Data (*Deserializer)(const QByteArray &, QString &, Kernel *);
+
+static void reportPeakMemory(const char *name, Deserializer deserializer, const QByteArray &jsonData)
+{
+    resetPeakResidentSetSize();
+    const qint64 rssBefore = procStatusValue("VmRSS");
+    {
+        QString errorMsg;
+        Storage::Data data = deserializer(jsonData, errorMsg, Q_NULLPTR);
+        QVERIFY(errorMsg.isEmpty());
+    }
+    const qint64 peak = procStatusValue("VmHWM");
+    if (rssBefore >= 0 && peak >= 0)
+        qDebug() << name << "peak RSS increase:" << (peak - rssBefore) << "kB";
+}
+
+TestBenchmarks::TestBenchmarks()
+    : TestBase()
+    , m_numTasks(DefaultNumTasks)
+{
+}
+
+void TestBenchmarks::initTestCase()
+{
+    bool ok = false;
+    const int numTasks = qgetenv("FLOW_BENCHMARK_TASKS").toInt(&ok);
+    if (ok && numTasks > 0)
+        m_numTasks = numTasks;
+
+    m_jsonData = syntheticJsonData(m_numTasks);
+    QString errorMsg;
+    m_binaryData = JsonStorage::serializeToBinaryData(JsonStorage::deserializeJsonData(m_jsonData, errorMsg, Q_NULLPTR));
+    qDebug() << "Generated" << m_numTasks << "tasks," << m_jsonData.size() / 1024 << "kB of json,"
+             << m_binaryData.size() / 1024 << "kB in binary format";
+}
+
+void TestBenchmarks::benchmarkLoadJsonDocument()
+{
+    reportPeakMemory("QJsonDocument", &JsonStorage::deserializeJsonDocument, m_jsonData);
+
+    QBENCHMARK {
+        QString errorMsg;
+        Storage::Data data = JsonStorage::deserializeJsonDocument(m_jsonData, errorMsg, Q_NULLPTR);
+        QCOMPARE(data.tasks.count(), m_numTasks);
+    }
+}
+
+void TestBenchmarks::benchmarkLoadJsonStream()
+{
+    reportPeakMemory("JsonStreamReader", &JsonStorage::deserializeJsonData, m_jsonData);
+
+    QBENCHMARK {
+        QString errorMsg;
+        Storage::Data data = JsonStorage::deserializeJsonData(m_jsonData, errorMsg, Q_NULLPTR);
+        QCOMPARE(data.tasks.count(), m_numTasks);
+    }
+}
+
+void TestBenchmarks::benchmarkLoadBinary()
+{
+    reportPeakMemory("BinarySerializer", &BinarySerializer::deserialize, m_binaryData);
+
+    QBENCHMARK {
+        QString errorMsg;
+        Storage::Data data = BinarySerializer::deserialize(m_binaryData, errorMsg, Q_NULLPTR);
+        QCOMPARE(data.tasks.count(), m_numTasks);
+    }
+}
+
+void TestBenchmarks::benchmarkLoadJsonParallel_data()
+{
+    QTest::addColumn<int>("threads");
+    for (int threads = 1; threads < QThread::idealThreadCount(); threads *= 2)
+        QTest::newRow(qPrintable(QString("%1 threads").arg(threads))) << threads;
+    QTest::newRow(qPrintable(QString("%1 threads").arg(QThread::idealThreadCount()))) << QThread::idealThreadCount();
+}
+
+void TestBenchmarks::benchmarkLoadJsonParallel()
+{
+    QFETCH(int, threads);
+    if (m_largeJsonData.isEmpty())
+        m_largeJsonData = syntheticJsonData(ParallelLoadNumTasks);
+
+    QBENCHMARK {
+        QString errorMsg;
+        Storage::Data data = JsonStorage::deserializeJsonData(m_largeJsonData, errorMsg, Q_NULLPTR, threads);
+        QCOMPARE(data.tasks.count(), int(ParallelLoadNumTasks));
+    }
+}
+
+void TestBenchmarks::benchmarkSaveJson()
+{
+    QString errorMsg;
+    const Storage::Data data = JsonStorage::deserializeJsonData(m_jsonData, errorMsg, Q_NULLPTR);
+    QBENCHMARK {
+        QVERIFY(!JsonStorage::serializeToJsonData(data).isEmpty());
+    }
+}
+
+void TestBenchmarks::benchmarkSaveBinary()
+{
+    QString errorMsg;
+    const Storage::Data data = JsonStorage::deserializeJsonData(m_jsonData, errorMsg, Q_NULLPTR);
+    QBENCHMARK {
+        QVERIFY(!JsonStorage::serializeToBinaryData(data).isEmpty());
+    }
+}
+
+// Per-task memory, with and without the context menu models that used to be created eagerly
+void TestBenchmarks::benchmarkTaskMenuModelFootprint()
+{
+    const int numTasks = qMin(m_numTasks, 10000);
+    m_storage->clearTasks();
+    m_storage->clearTags();
+    for (int i = 0; i < NumTags; ++i)
+        m_storage->createTag(QString("tag%1").arg(i));
+
+    QList<Task::Ptr> tasks;
+    tasks.reserve(numTasks);
+#if defined(__GLIBC__)
+    malloc_trim(0);
+#endif
+    const qint64 rssBefore = procStatusValue("VmRSS");
+    for (int i = 0; i < numTasks; ++i)
+        tasks << Task::createTask(m_kernel, QString("Task %1").arg(i));
+    const qint64 rssWithoutMenuModels = procStatusValue("VmRSS");
+
+    foreach (const Task::Ptr &task, tasks) {
+        QVERIFY(task->sortedContextMenuModel());
+        QVERIFY(task->checkableTagModel());
+    }
+    const qint64 rssWithMenuModels = procStatusValue("VmRSS");
+
+    if (rssBefore >= 0) {
+        qDebug() << "Per task without menu models:" << (rssWithoutMenuModels - rssBefore) * 1024 / numTasks << "bytes";
+        qDebug() << "Per task with menu models:" << (rssWithMenuModels - rssBefore) * 1024 / numTasks << "bytes";
+    }
+
+    QBENCHMARK {
+        m_storage->createTag("extraTag"); // Every live menu model gets notified
+        m_storage->removeTag("extraTag");
+    }
+
+    foreach (const Task::Ptr &task, tasks)
+        task->releaseMenuModels();
+    QCoreApplication::sendPostedEvents(Q_NULLPTR, QEvent::DeferredDelete);
+    tasks.clear();
+    m_storage->clearTags();
+}
+
+// Every TagRef created while loading looks its tag up by name
+void TestBenchmarks::benchmarkLoadManyTags()
+{
+    const QByteArray jsonData = syntheticJsonData(50000, 1000);
+    QBENCHMARK {
+        QString errorMsg;
+        Storage::Data data = JsonStorage::deserializeJsonData(jsonData, errorMsg, m_kernel);
+        QVERIFY(errorMsg.isEmpty());
+        QCOMPARE(data.tags.count(), 1000);
+        m_storage->setData(data);
+        Storage::Data empty; // clearTasks() is quadratic, just drop everything
+        m_storage->setData(empty);
+    }
+}
+
+void TestBenchmarks::benchmarkToggleStaged_data()
+{
+    QTest::addColumn<bool>("rowLevelFiltering");
+    QTest::newRow("invalidate proxies") << false;
+    QTest::newRow("row level") << true;
+}
+
+void TestBenchmarks::benchmarkToggleStaged()
+{
+    QFETCH(bool, rowLevelFiltering);
+
+    RuntimeConfiguration config;
+    config.setDataFileName("unit-test-benchmark.dat");
+    config.setPluginsSupported(false);
+    config.setSaveEnabled(false);
+    config.setRowLevelFiltering(rowLevelFiltering);
+    config.setSettings(new Settings("unit-test-settings.ini"));
+    Kernel kernel(config);
+    Storage *storage = kernel.storage();
+
+    QString errorMsg;
+    Storage::Data data = JsonStorage::deserializeJsonData(m_jsonData, errorMsg, &kernel);
+    QVERIFY(errorMsg.isEmpty());
+    storage->setData(data);
+    QCOMPARE(storage->taskCount(), m_numTasks);
+
+    Task::Ptr task = storage->taskAt(m_numTasks / 2);
+    const int stagedCount = storage->stagedTasksModel()->rowCount();
+    QBENCHMARK {
+        task->setStaged(!task->staged());
+    }
+
+    task->setStaged(false);
+    QVERIFY(storage->stagedTasksModel()->rowCount() <= stagedCount);
+}
+
+void TestBenchmarks::benchmarkSortTasks()
+{
+    QString errorMsg;
+    const Storage::Data data = JsonStorage::deserializeJsonData(m_jsonData, errorMsg, Q_NULLPTR);
+    TaskList tasks;
+    tasks.append(data.tasks);
+
+    TaskFilterProxyModel model;
+    model.setSourceModel(tasks);
+    QCOMPARE(model.rowCount(), m_numTasks);
+
+    QBENCHMARK {
+        model.invalidate(); // Filters and sorts everything again
+    }
+}
+
+// Filters the five standard views again, from Storage's task columns
+void TestBenchmarks::benchmarkFilterViews()
+{
+    QString errorMsg;
+    Storage::Data data = JsonStorage::deserializeJsonData(m_jsonData, errorMsg, m_kernel);
+    m_storage->setData(data);
+    QList<TaskFilterProxyModel*> views;
+    views << m_storage->taskFilterModel() << m_storage->stagedTasksModel() << m_storage->archivedTasksModel()
+          << m_storage->untaggedTasksModel() << m_storage->dueDateTasksModel();
+    QCOMPARE(m_storage->stagedTasksModel()->rowCount(), (m_numTasks + 9) / 10);
+
+    QBENCHMARK {
+        foreach (TaskFilterProxyModel *view, views)
+            view->invalidateFilter();
+    }
+
+    Storage::Data empty;
+    m_storage->setData(empty);
+}
+
+void TestBenchmarks::benchmarkTaskListData()
+{
+    QString errorMsg;
+    Storage::Data data = JsonStorage::deserializeJsonData(m_jsonData, errorMsg, m_kernel);
+    m_storage->setData(data);
+    QAbstractItemModel *model = m_storage->taskFilterModel()->sourceModel();
+
+    QBENCHMARK {
+        QCOMPARE(readAllRoles(model), m_numTasks * 2);
+    }
+
+    Storage::Data empty;
+    m_storage->setData(empty);
+}
+
+void TestBenchmarks::benchmarkTagListData()
+{
+    // Tags are few, so go through them many times
+    m_storage->clearTags();
+    for (int i = 0; i < NumTags; ++i)
+        m_storage->createTag(QString("tag%1").arg(i));
+    QAbstractItemModel *model = static_cast<QAbstractProxyModel*>(m_storage->tagsModel())->sourceModel();
+
+    QBENCHMARK {
+        for (int i = 0; i < 1000; ++i)
+            QCOMPARE(readAllRoles(model), NumTags * 2);
+    }
+
+    m_storage->clearTags();
+}
@@ -0,0 +1,60 @@
+/*
+  This file is part of Flow.
+
+  Copyright (C) 2015 Sérgio Martins <iamsergio@gmail.com>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FLOW_TEST_BENCHMARKS_H
+#define FLOW_TEST_BENCHMARKS_H
+
+#include "testbase.h"
+#include <QtTest/QtTest>
+
+// Only runs when FLOW_BENCHMARKS is set in the environment.
+// FLOW_BENCHMARK_TASKS overrides the number of tasks in the generated data.
+class TestBenchmarks: public TestBase
+{
+    Q_OBJECT
+public:
+    TestBenchmarks();
+
+private Q_SLOTS:
+    void initTestCase();
+
+    void benchmarkLoadJsonDocument();
+    void benchmarkLoadJsonStream();
+    void benchmarkLoadBinary();
+    void benchmarkLoadJsonParallel_data();
+    void benchmarkLoadJsonParallel();
+    void benchmarkSaveJson();
+    void benchmarkSaveBinary();
+    void benchmarkTaskMenuModelFootprint();
+    void benchmarkLoadManyTags();
+    void benchmarkToggleStaged_data();
+    void benchmarkToggleStaged();
+    void benchmarkSortTasks();
+    void benchmarkFilterViews();
+    void benchmarkTaskListData();
+    void benchmarkTagListData();
+
+private:
+    int m_numTasks;
+    QByteArray m_jsonData;
+    QByteArray m_binaryData;
+    QByteArray m_largeJsonData; // Only generated when the parallel load benchmark runs
+};
+
+#endif
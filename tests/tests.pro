@@ -17,6 +17,7 @@ SOURCES += assertingproxymodel.cpp \
            signalspy.cpp \
            testarchivedtasksmodel.cpp \
            testbase.cpp \
+           testbenchmarks.cpp \
            testcheckabletagmodel.cpp \
            teststagedtasksmodel.cpp \
            teststorage.cpp \
@@ -42,6 +43,7 @@ HEADERS += assertingproxymodel.h \
            testtaskfiltermodel.h \
            teststorage.h \
            testbase.h \
+           testbenchmarks.h \
            teststagedtasksmodel.h \
            testtag.h \
            testtask.h \
@@ -19,6 +19,18 @@
 
 #include "teststorage.h"
 #include "storage.h"
+#include "jsonstorage.h"
+#include "binaryserializer.h"
+#include "storagewriter.h"
+#include "sqlitestorage.h"
+#include "modelsignalspy.h"
+#include "taskfilterproxymodel.h"
+#include "kernel.h"
+#include "runtimeconfiguration.h"
+#include "taskstatistics.h"
+#include "taskcolumns.h"
+
+#include <QFileInfo>
 
 TestStorage::TestStorage() : TestBase()
 {
@@ -139,6 +151,17 @@ void TestStorage::testIndexOf()
    QCOMPARE(m_storage->indexOfTag("2"), 2);
    QCOMPARE(m_storage->indexOfTag("3A "), 3); // has space and uppercase
    QCOMPARE(m_storage->indexOfTag("4"), -1);
+
+   // The name index follows removals, which shift rows, and renames
+   m_storage->removeTag("1");
+   QCOMPARE(m_storage->indexOfTag("1"), -1);
+   QCOMPARE(m_storage->indexOfTag("2"), 1);
+   QCOMPARE(m_storage->indexOfTag("3a"), 2);
+   m_storage->tag("2")->setName("Two");
+   QCOMPARE(m_storage->indexOfTag("2"), -1);
+   QCOMPARE(m_storage->indexOfTag("two"), 1);
+   m_storage->createTag("4");
+   QCOMPARE(m_storage->indexOfTag("4"), 3);
 }
 
 void TestStorage::testRenameTag()
@@ -221,3 +244,734 @@ void TestStorage::testSaveCount()
     qApp->processEvents();
     QCOMPARE(m_storage->saveCallCount - saveCountStart, 1);
 }
+
+void TestStorage::testJournal()
+{
+    RuntimeConfiguration config = savingConfiguration("journal.dat");
+    config.setJournalEnabled(true);
+
+    {
+        QScopedPointer<Kernel> kernel(createSessionKernel(config));
+        JsonStorage *storage = qobject_cast<JsonStorage*>(kernel->storage());
+        QVERIFY(storage);
+        Task::Ptr task1 = storage->addTask("task1");
+        Task::Ptr task2 = storage->addTask("task2");
+        storage->save(); // There's no data file yet, so this one is a full save
+        QVERIFY(storage->savingInProgress()); // Written by the writer thread
+        QTRY_VERIFY(!storage->savingInProgress());
+        QVERIFY(QFile::exists(config.dataFileName()));
+        QVERIFY(!QFile::exists(storage->journalFileName()));
+        const qint64 snapshotSize = QFileInfo(config.dataFileName()).size();
+
+        task1->setSummary("task1 renamed");
+        storage->addTask("task3");
+        storage->prependTask("task0");
+        storage->removeTask(task2);
+        storage->save();
+        QTRY_VERIFY(!storage->savingInProgress());
+        QVERIFY(QFile::exists(storage->journalFileName()));
+        QCOMPARE(QFileInfo(config.dataFileName()).size(), snapshotSize); // Not rewritten
+
+        task1->setDescription("written when the storage is destroyed");
+        task1->addTag("work");
+        task1->setStaged(true);
+    }
+
+    {
+        QScopedPointer<Kernel> kernel(createSessionKernel(config));
+        Storage *storage = kernel->storage();
+        QCOMPARE(storage->taskCount(), 3);
+        QCOMPARE(storage->taskAt(0)->summary(), QString("task0")); // Still on top
+        QCOMPARE(storage->taskAt(1)->summary(), QString("task1 renamed"));
+        QCOMPARE(storage->taskAt(1)->description(), QString("written when the storage is destroyed"));
+        QCOMPARE(storage->taskAt(2)->summary(), QString("task3"));
+
+        // Replayed modifications reach the indexes and the proxies
+        QCOMPARE(storage->stagedTasksModel()->rowCount(), 1);
+        QCOMPARE(storage->untaggedTasksModel()->rowCount(), 2);
+        Tag::Ptr tag = storage->tag("work", /*create=*/ false);
+        QVERIFY(tag);
+        QCOMPARE(tag->taskCount(), 1);
+        QCOMPARE(tag->taggedTasks(), QList<Task*>() << storage->taskAt(1).data());
+    }
+}
+
+void TestStorage::testStreamingDeserializer()
+{
+    const QByteArray json = "{ \"JsonSerializerVersion\": 1, \"instanceId\": \"{abc}\", \"unknown\": { \"nested\": [1, 2, {}] },"
+                            "\"tags\": [ {\"name\": \"work\", \"revision\": 3, \"uuid\": \"{t1}\"}, {\"name\": \"\"}, \"garbage\" ],"
+                            "\"tasks\": [ {\"summary\": \"say \\\"hi\\\"\\n\\u00e9\", \"description\": \"d\", \"staged\": true, \"priority\": 2,"
+                            "               \"creationTimestamp\": 1420070400000, \"dueDate\": 2457024, \"tags\": [\"work\", \"\"], \"extra\": [[]],"
+                            "               \"revision\": 5, \"revisionOnWebDAVServer\": 4, \"uuid\": \"{u1}\"},"
+                            "             {} ] }";
+
+    QString streamError;
+    QString documentError;
+    Storage::Data streamed = JsonStorage::deserializeJsonData(json, streamError, Q_NULLPTR);
+    Storage::Data reference = JsonStorage::deserializeJsonDocument(json, documentError, Q_NULLPTR);
+    QVERIFY(streamError.isEmpty());
+    QVERIFY(documentError.isEmpty());
+
+    QCOMPARE(streamed.instanceId, QByteArray("{abc}"));
+    QCOMPARE(streamed.instanceId, reference.instanceId);
+    QCOMPARE(streamed.tags.count(), 1);
+    QCOMPARE(streamed.tags.count(), reference.tags.count());
+    QCOMPARE(streamed.tags.at(0)->name(), reference.tags.at(0)->name());
+    QCOMPARE(streamed.tags.at(0)->uuid(), reference.tags.at(0)->uuid());
+    QCOMPARE(streamed.tags.at(0)->revision(), reference.tags.at(0)->revision());
+
+    QCOMPARE(streamed.tasks.count(), 2);
+    QCOMPARE(streamed.tasks.count(), reference.tasks.count());
+    QCOMPARE(streamed.tasks.at(0)->summary(), QString::fromUtf8("say \"hi\"\n\xc3\xa9"));
+    for (int i = 0; i < streamed.tasks.count(); ++i) {
+        Task::Ptr task = streamed.tasks.at(i);
+        Task::Ptr expected = reference.tasks.at(i);
+        QCOMPARE(task->summary(), expected->summary());
+        QCOMPARE(task->description(), expected->description());
+        QCOMPARE(task->staged(), expected->staged());
+        QCOMPARE(task->priority(), expected->priority());
+        QCOMPARE(task->creationDate(), expected->creationDate());
+        QCOMPARE(task->dueDate(), expected->dueDate());
+        QCOMPARE(task->tags().count(), expected->tags().count());
+        for (int j = 0; j < task->tags().count(); ++j)
+            QCOMPARE(task->tags().at(j).tagName(), expected->tags().at(j).tagName());
+        QCOMPARE(task->revision(), expected->revision());
+        QCOMPARE(task->revisionOnWebDAVServer(), expected->revisionOnWebDAVServer());
+        if (i == 0)
+            QCOMPARE(task->uuid(), expected->uuid());
+    }
+
+    JsonStorage::deserializeJsonData("{ \"tasks\": [ {\"summary\": \"unterminated } ] }", streamError, Q_NULLPTR);
+    QVERIFY(!streamError.isEmpty());
+    JsonStorage::deserializeJsonData("{ \"JsonSerializerVersion\": 1000 }", streamError, Q_NULLPTR);
+    QVERIFY(!streamError.isEmpty());
+}
+
+void TestStorage::testBinaryRoundTrip()
+{
+    QByteArray json = "{ \"instanceId\": \"{abc}\", \"tags\": [ {\"name\": \"work\", \"revision\": 3, \"uuid\": \"{not-a-uuid}\"},"
+                      "                                      {\"name\": \"home\", \"revisionOnWebDAVServer\": 2} ],"
+                      "\"tasks\": [ {\"summary\": \"\\u00e9t\\u00e9\", \"description\": \"d\", \"staged\": true, \"priority\": 2,"
+                      "               \"creationTimestamp\": 1420070400000, \"modificationTimestamp\": 1420070400001,"
+                      "               \"lastPomodoroDate\": 1420070400002, \"dueDate\": 2457024, \"tags\": [\"work\", \"home\", \"orphan\"],"
+                      "               \"revision\": 5, \"revisionOnWebDAVServer\": -1, \"uuid\": \"{0c73b70f-b483-4ee4-97f3-1eb839faa63a}\"},"
+                      "             {\"summary\": \"plain\", \"creationTimestamp\": 1420070400000} ] }";
+
+    QString errorMsg;
+    Storage::Data original = JsonStorage::deserializeJsonData(json, errorMsg, Q_NULLPTR);
+    QVERIFY(errorMsg.isEmpty());
+
+    const QByteArray binary = JsonStorage::serializeToBinaryData(original);
+    QVERIFY(BinarySerializer::isBinaryData(binary));
+    QVERIFY(!BinarySerializer::isBinaryData(JsonStorage::serializeToJsonData(original)));
+
+    Storage::Data loaded = BinarySerializer::deserialize(binary, errorMsg, Q_NULLPTR);
+    QVERIFY(errorMsg.isEmpty());
+    QCOMPARE(loaded.instanceId, original.instanceId);
+    QCOMPARE(loaded.tags.count(), original.tags.count());
+    for (int i = 0; i < loaded.tags.count(); ++i) {
+        QCOMPARE(loaded.tags.at(i)->name(), original.tags.at(i)->name());
+        QCOMPARE(loaded.tags.at(i)->uuid(), original.tags.at(i)->uuid());
+        QCOMPARE(loaded.tags.at(i)->revision(), original.tags.at(i)->revision());
+        QCOMPARE(loaded.tags.at(i)->revisionOnWebDAVServer(), original.tags.at(i)->revisionOnWebDAVServer());
+    }
+
+    QCOMPARE(loaded.tasks.count(), original.tasks.count());
+    for (int i = 0; i < loaded.tasks.count(); ++i) {
+        Task::Ptr task = loaded.tasks.at(i);
+        Task::Ptr expected = original.tasks.at(i);
+        QCOMPARE(task->toJson(), expected->toJson()); // covers every serialized field
+    }
+
+    // Truncated data is detected
+    QVERIFY(!BinarySerializer::deserialize(binary.left(binary.size() - 3), errorMsg, Q_NULLPTR).tasks.count());
+    QVERIFY(!errorMsg.isEmpty());
+
+    // Much smaller than json, and picked up by JsonStorage when loading
+    Storage::Data bigData;
+    for (int i = 0; i < 200; ++i) {
+        Task::Ptr task = Task::createTask(Q_NULLPTR, QString("Task number %1").arg(i));
+        task->setDescription("Some description");
+        task->setTagList(TagRef::List() << TagRef(task.data(), "work", Q_NULLPTR));
+        bigData.tasks << task;
+    }
+
+    const QByteArray bigJson = JsonStorage::serializeToJsonData(bigData);
+    const QByteArray bigBinary = JsonStorage::serializeToBinaryData(bigData);
+    QVERIFY(bigBinary.size() * 3 < bigJson.size());
+
+    RuntimeConfiguration config = savingConfiguration("binary.dat");
+    config.setStorageFormat(RuntimeConfiguration::StorageFormatBinary);
+    {
+        QScopedPointer<Kernel> kernel(createSessionKernel(config));
+        kernel->storage()->addTask("task1")->setDescription("description");
+        kernel->storage()->save();
+        QTRY_VERIFY(!kernel->storage()->savingInProgress());
+    }
+
+    QFile file(config.dataFileName());
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QVERIFY(BinarySerializer::isBinaryData(file.readAll()));
+    file.close();
+
+    config.setStorageFormat(RuntimeConfiguration::StorageFormatJson);
+    {
+        QScopedPointer<Kernel> kernel(createSessionKernel(config));
+        QCOMPARE(kernel->storage()->taskCount(), 1);
+        QCOMPARE(kernel->storage()->taskAt(0)->summary(), QString("task1"));
+        QCOMPARE(kernel->storage()->taskAt(0)->description(), QString("description"));
+    }
+}
+
+void TestStorage::testAtomicSave()
+{
+    RuntimeConfiguration config = savingConfiguration("atomic.dat");
+    config.setJournalEnabled(false);
+    config.setBackupGenerations(2);
+
+    QScopedPointer<Kernel> kernel(createSessionKernel(config));
+    JsonStorage *storage = qobject_cast<JsonStorage*>(kernel->storage());
+    QVERIFY(storage);
+
+    for (int i = 1; i <= 3; ++i) {
+        storage->addTask(QString("task%1").arg(i));
+        storage->save();
+        QTRY_VERIFY(!storage->savingInProgress());
+
+        // The payload is written once, backups are hard links where supported
+        const qint64 fileSize = QFileInfo(config.dataFileName()).size();
+#if defined(Q_OS_UNIX)
+        QCOMPARE(storage->lastSaveBytesWritten(), fileSize);
+#else
+        QVERIFY(storage->lastSaveBytesWritten() >= fileSize);
+#endif
+    }
+
+    QVERIFY(!QFile::exists(config.dataFileName() + "~"));
+    QVERIFY(QFile::exists(StorageWriter::backupFileName(config.dataFileName(), 1)));
+    QVERIFY(QFile::exists(StorageWriter::backupFileName(config.dataFileName(), 2)));
+    QVERIFY(!QFile::exists(StorageWriter::backupFileName(config.dataFileName(), 3)));
+    QVERIFY(QFileInfo(StorageWriter::backupFileName(config.dataFileName(), 2)).size()
+            < QFileInfo(StorageWriter::backupFileName(config.dataFileName(), 1)).size());
+    QVERIFY(storage->totalBytesWritten() > storage->lastSaveBytesWritten());
+}
+
+void TestStorage::testSaveCoalescing()
+{
+    RuntimeConfiguration config = savingConfiguration("coalescing.dat");
+    config.setSaveQuietPeriod(50);
+    config.setSaveMaxStaleness(300);
+
+    QScopedPointer<Kernel> kernel(createSessionKernel(config));
+    Storage *storage = kernel->storage();
+    const int requestsStart = storage->saveRequestCount();
+    const int savesStart = storage->performedSaveCount();
+
+    // A burst of edits is written once
+    Task::Ptr task = storage->addTask("task");
+    for (int i = 0; i < 20; ++i)
+        task->setSummary(QString("summary %1").arg(i));
+    QVERIFY(storage->saveScheduled());
+    QCOMPARE(storage->performedSaveCount(), savesStart);
+    QTRY_COMPARE(storage->performedSaveCount(), savesStart + 1);
+    QVERIFY(storage->saveRequestCount() - requestsStart > 20);
+
+    // Continuous editing never gets a quiet period, the staleness bound still saves
+    const int savesBefore = storage->performedSaveCount();
+    QElapsedTimer timer;
+    timer.start();
+    int i = 0;
+    while (timer.elapsed() < 700) {
+        task->setSummary(QString("typing %1").arg(++i));
+        QTest::qWait(10);
+    }
+    QVERIFY(storage->performedSaveCount() > savesBefore);
+    QVERIFY(storage->performedSaveCount() - savesBefore < i);
+    QTRY_VERIFY(!storage->savingInProgress());
+}
+
+void TestStorage::testSqliteStorage()
+{
+    RuntimeConfiguration config = savingConfiguration("sqlite.dat");
+
+    // Start with a regular data file, which gets imported
+    {
+        QScopedPointer<Kernel> kernel(createSessionKernel(config));
+        Storage *storage = kernel->storage();
+        Task::Ptr task = storage->addTask("imported");
+        task->addTag("work");
+        task->setDueDate(QDate(2015, 1, 1));
+        storage->addTask("second");
+        storage->save();
+        QTRY_VERIFY(!storage->savingInProgress());
+
+        // Only in the journal, it must be imported too
+        storage->addTask("journaled");
+        storage->save();
+        QTRY_VERIFY(!storage->savingInProgress());
+        QVERIFY(QFile::exists(JsonStorage::journalFileName(config.dataFileName())));
+    }
+
+    config.setStorageBackend(RuntimeConfiguration::StorageBackendSqlite);
+    {
+        QScopedPointer<Kernel> kernel(createSessionKernel(config));
+        SqliteStorage *storage = qobject_cast<SqliteStorage*>(kernel->storage());
+        QVERIFY(storage);
+        QVERIFY(QFile::exists(storage->databaseFileName()));
+        QCOMPARE(storage->taskCount(), 3);
+        QCOMPARE(storage->taskAt(0)->summary(), QString("imported"));
+        QCOMPARE(storage->taskAt(2)->summary(), QString("journaled"));
+        QCOMPARE(storage->taskUuidsForTag("WORK"), QStringList() << storage->taskAt(0)->uuid());
+        QCOMPARE(storage->taskUuidsDueUntil(QDate(2015, 1, 2)), QStringList() << storage->taskAt(0)->uuid());
+        QVERIFY(storage->taskUuidsDueUntil(QDate(2014, 12, 31)).isEmpty());
+
+        storage->taskAt(0)->setSummary("renamed");
+        storage->taskAt(0)->removeTag("work");
+        storage->removeTask(storage->taskAt(1));
+        storage->prependTask("first");
+        storage->addTask("last");
+        storage->save();
+    }
+
+    {
+        QScopedPointer<Kernel> kernel(createSessionKernel(config));
+        SqliteStorage *storage = qobject_cast<SqliteStorage*>(kernel->storage());
+        QVERIFY(storage);
+        QCOMPARE(storage->taskCount(), 4);
+        QCOMPARE(storage->taskAt(0)->summary(), QString("first"));
+        QCOMPARE(storage->taskAt(1)->summary(), QString("renamed"));
+        QVERIFY(storage->taskAt(1)->tags().isEmpty());
+        QCOMPARE(storage->taskAt(1)->dueDate(), QDate(2015, 1, 1));
+        QCOMPARE(storage->taskAt(2)->summary(), QString("journaled"));
+        QCOMPARE(storage->taskAt(3)->summary(), QString("last"));
+        QVERIFY(storage->taskUuidsForTag("work").isEmpty());
+        QVERIFY(storage->containsTag("work"));
+    }
+}
+
+void TestStorage::testBulkLoad()
+{
+    // Range append emits the correct range, and nothing for an empty list
+    TaskList list;
+    QSignalSpy insertSpy(static_cast<QAbstractListModel*>(list), SIGNAL(rowsInserted(QModelIndex,int,int)));
+    list.append(QList<Task::Ptr>());
+    QCOMPARE(insertSpy.count(), 0);
+    list.append(QList<Task::Ptr>() << Task::createTask(Q_NULLPTR, "a") << Task::createTask(Q_NULLPTR, "b"));
+    QCOMPARE(insertSpy.count(), 1);
+    QCOMPARE(insertSpy.at(0).at(1).toInt(), 0);
+    QCOMPARE(insertSpy.at(0).at(2).toInt(), 1);
+    list.clear();
+
+    RuntimeConfiguration config = savingConfiguration("bulk.dat");
+    {
+        QScopedPointer<Kernel> kernel(createSessionKernel(config));
+        for (int i = 0; i < 50; ++i)
+            kernel->storage()->addTask(QString("task%1").arg(i));
+        kernel->storage()->save();
+        QTRY_VERIFY(!kernel->storage()->savingInProgress());
+    }
+
+    QScopedPointer<Kernel> kernel(createSessionKernel(config, /*load=*/ false));
+    Storage *storage = kernel->storage();
+    ModelSignalSpy modelSpy(storage->taskFilterModel());
+    QSignalSpy countSpy(storage, SIGNAL(taskCountChanged()));
+    storage->load();
+    QCOMPARE(storage->taskCount(), 50);
+
+    int insertions = 0;
+    foreach (const CaughtSignal &signal, modelSpy.caughtSignals()) {
+        if (signal.name == "rowsInserted")
+            ++insertions;
+    }
+    QCOMPARE(insertions, 1);
+    QCOMPARE(countSpy.count(), 2); // One for the bulk insertion, one when load() finishes
+}
+
+void TestStorage::testTaskIndex()
+{
+    m_storage->clearTasks();
+    m_storage->clearTags();
+    Task::Ptr task1 = m_storage->addTask("t1");
+    Task::Ptr task2 = m_storage->prependTask("t2");
+    QCOMPARE(m_storage->taskForUuid(task1->uuid()), task1);
+    QCOMPARE(m_storage->taskForUuid(task2->uuid()), task2);
+    QCOMPARE(m_storage->indexOfTask(task1), 1);
+    QVERIFY(!m_storage->taskForUuid("{00000000-0000-0000-0000-000000000000}"));
+
+    m_storage->removeTask(task1);
+    QVERIFY(!m_storage->taskForUuid(task1->uuid()));
+    QCOMPARE(m_storage->indexOfTask(task1), -1);
+
+    // Duplicates, as a bad merge could produce
+    Task::Ptr duplicate = Task::createTask(m_kernel, "t2 copy", task2->uuid());
+    Storage::Data data = m_storage->data();
+    data.tasks << duplicate << task1;
+    data.tags << m_storage->createTag("tagA") << m_storage->createTag("tagA");
+    m_storage->setData(data);
+    QCOMPARE(m_storage->taskCount(), 3);
+    QCOMPARE(m_storage->taskForUuid(task2->uuid()), task2); // First one wins
+    QCOMPARE(m_storage->taskForUuid(task1->uuid()), task1); // Reset rebuilds the index
+
+    QCOMPARE(m_storage->removeDuplicateData(), 2);
+    QCOMPARE(m_storage->taskCount(), 2);
+    QCOMPARE(m_storage->tags().count(), 1);
+    QCOMPARE(m_storage->taskForUuid(task2->uuid()), task2);
+    QCOMPARE(m_storage->removeDuplicateData(), 0);
+    m_storage->clearTasks();
+    m_storage->clearTags();
+}
+
+void TestStorage::testRowLevelFiltering()
+{
+    RuntimeConfiguration config = savingConfiguration("row-level.dat");
+    config.setSaveEnabled(false);
+    config.setRowLevelFiltering(true);
+    QScopedPointer<Kernel> kernel(createSessionKernel(config, /*load=*/ false));
+    Storage *storage = kernel->storage();
+
+    Task::Ptr task1 = storage->addTask("task1");
+    Task::Ptr task2 = storage->addTask("task2");
+    QCOMPARE(storage->stagedTasksModel()->rowCount(), 0);
+    QCOMPARE(storage->archivedTasksModel()->rowCount(), 2);
+    QCOMPARE(storage->untaggedTasksModel()->rowCount(), 2);
+
+    ModelSignalSpy modelSpy(storage->archivedTasksModel());
+    task1->setStaged(true);
+    QCOMPARE(storage->stagedTasksModel()->rowCount(), 1);
+    QCOMPARE(storage->archivedTasksModel()->rowCount(), 1);
+    QVERIFY(!modelSpy.caughtSignals().isEmpty());
+    foreach (const CaughtSignal &signal, modelSpy.caughtSignals())
+        QVERIFY(signal.name != "layoutChanged" && signal.name != "modelReset"); // Not invalidated
+
+    task2->addTag("tagA");
+    QCOMPARE(storage->untaggedTasksModel()->rowCount(), 0);
+    task2->setDueDate(QDate::currentDate());
+    QCOMPARE(storage->dueDateTasksModel()->rowCount(), 1);
+
+    task1->setStaged(false);
+    task1->setPriority(Task::PriorityHigh);
+    QCOMPARE(storage->archivedTasksModel()->rowCount(), 2);
+    QCOMPARE(storage->archivedTasksModel()->data(storage->archivedTasksModel()->index(0, 0),
+                                                  Storage::TaskPtrRole).value<Task::Ptr>(), task1);
+
+    // Rows moved by a prepend, the change still reaches the task's new row
+    storage->prependTask("task0");
+    QCOMPARE(storage->untaggedTasksModel()->rowCount(), 2);
+    task2->removeTag("tagA");
+    QCOMPARE(storage->untaggedTasksModel()->rowCount(), 3);
+}
+
+void TestStorage::testReadOnlyViews()
+{
+    m_storage->clearTasks();
+    m_storage->clearTags();
+    Task::Ptr task1 = m_storage->addTask("task1");
+    Task::Ptr task2 = m_storage->addTask("task2");
+    task1->addTag("tagA");
+    task1->addTag("tagB");
+    task2->addTag("tagA");
+
+    // Read access doesn't create models
+    const int allocations = _InternalModelBase::allocationCount();
+    int numTagRefs = 0;
+    foreach (const Task::Ptr &task, m_storage->tasks()) {
+        foreach (const TagRef &tagRef, task->tags())
+            numTagRefs += tagRef.tag() ? 1 : 0;
+    }
+    QCOMPARE(numTagRefs, 3);
+    QCOMPARE(m_storage->tags().count(), 2);
+    QVERIFY(!task1->equals(task2.data()));
+    QVERIFY(checkStorageConsistency());
+    m_storage->archivedTasksModel()->invalidate();
+    QCOMPARE(_InternalModelBase::allocationCount(), allocations);
+
+    // Explicit copies still work, and do create one
+    TaskList copy = m_storage->tasks();
+    QCOMPARE(copy.count(), 2);
+    QCOMPARE(_InternalModelBase::allocationCount(), allocations + 1);
+
+    m_storage->clearTasks();
+    m_storage->clearTags();
+}
+
+void TestStorage::testDueDateIndex()
+{
+    m_storage->clearTasks();
+    const QDate today = QDate::currentDate();
+    Task::Ptr overdue = m_storage->addTask("overdue");
+    Task::Ptr dueToday = m_storage->addTask("due today");
+    Task::Ptr later = m_storage->addTask("later");
+    Task::Ptr undated = m_storage->addTask("undated");
+    overdue->setDueDate(today.addDays(-1));
+    dueToday->setDueDate(today);
+    later->setDueDate(today.addDays(30));
+    foreach (const Task::Ptr &task, m_storage->tasks())
+        task->setStaged(false);
+
+    QSignalSpy laterSpy(later.data(), SIGNAL(dueStatusChanged()));
+    QSignalSpy undatedSpy(undated.data(), SIGNAL(dueStatusChanged()));
+    const int revision = dueToday->revision();
+    emit m_kernel->dayChanged();
+
+    // Only tasks becoming due are visited, and the day change isn't an edit
+    QVERIFY(overdue->staged());
+    QVERIFY(dueToday->staged());
+    QVERIFY(!later->staged());
+    QVERIFY(!undated->staged());
+    QCOMPARE(laterSpy.count(), 0);
+    QCOMPARE(undatedSpy.count(), 0);
+    QCOMPARE(dueToday->revision(), revision + 1); // +1 from setStaged()
+    QCOMPARE(m_storage->stagedTasksModel()->rowCount(), 2);
+
+    // Removed and re-dated tasks leave their old buckets
+    m_storage->removeTask(overdue);
+    later->setDueDate(today);
+    dueToday->setStaged(false);
+    emit m_kernel->dayChanged();
+    QVERIFY(dueToday->staged());
+    QVERIFY(later->staged());
+    QCOMPARE(m_storage->stagedTasksModel()->rowCount(), 2);
+
+    // Overdue tasks unstaged after an earlier scan come back on the next one
+    Task::Ptr longOverdue = m_storage->addTask("long overdue");
+    longOverdue->setDueDate(today.addDays(-2));
+    emit m_kernel->dayChanged();
+    longOverdue->setStaged(false);
+    emit m_kernel->dayChanged();
+    QVERIFY(longOverdue->staged());
+
+    m_storage->clearTasks();
+}
+
+void TestStorage::testStatistics()
+{
+    m_storage->clearTasks();
+    TaskStatistics *statistics = m_storage->statistics();
+    QCOMPARE(statistics->taskCount(), 0);
+    QCOMPARE(statistics->ageAverage(), 0);
+
+    const qint64 day = 24 * 3600 * 1000LL;
+    const qint64 now = QDateTime::currentDateTime().toMSecsSinceEpoch();
+    Storage::Data data;
+    for (int i = 0; i < 10; ++i) {
+        TaskRecord record;
+        record.summary = QString("task%1").arg(i);
+        record.creationTimestamp = now - i * 3 * day;
+        record.staged = i < 4;
+        if (i < 3) {
+            record.hasDueDate = true;
+            record.dueDate = QDate::currentDate().addDays(i - 1).toJulianDay(); // Only the first is overdue
+        }
+        Task::Ptr task = Task::createTask(m_kernel);
+        task->fromRecord(record);
+        data.tasks << task;
+    }
+    m_storage->setData(data);
+
+    QCOMPARE(statistics->taskCount(), 10);
+    QCOMPARE(statistics->stagedCount(), 4);
+    QCOMPARE(statistics->archivedCount(), 6);
+    QCOMPARE(statistics->overdueCount(), 1);
+
+    int totalAge = 0;
+    foreach (const Task::Ptr &task, m_storage->tasks())
+        totalAge += task->daysSinceCreation();
+    QCOMPARE(statistics->ageAverage(), totalAge / 10);
+    QCOMPARE(m_storage->ageAverage(), statistics->ageAverage());
+
+    // Changes, removals and additions are accounted incrementally
+    Task::Ptr task = m_storage->taskAt(0);
+    task->setStaged(false);
+    task->removeDueDate();
+    QCOMPARE(statistics->stagedCount(), 3);
+    QCOMPARE(statistics->overdueCount(), 0);
+    m_storage->removeTask(m_storage->taskAt(9));
+    m_storage->addTask("new task");
+    QCOMPARE(statistics->taskCount(), 10);
+    QCOMPARE(statistics->stagedCount(), m_storage->stagedTasksModel()->rowCount());
+
+    m_storage->clearTasks();
+    QCOMPARE(statistics->taskCount(), 0);
+}
+
+void TestStorage::testArchive()
+{
+    RuntimeConfiguration config = savingConfiguration("archive.dat");
+    config.setArchiveAfterDays(30);
+    config.setJournalEnabled(true);
+
+    {
+        QScopedPointer<Kernel> kernel(createSessionKernel(config));
+        JsonStorage *storage = qobject_cast<JsonStorage*>(kernel->storage());
+        QVERIFY(storage);
+        storage->addTask("recent")->addTag("work");
+        Task::Ptr oldTask = storage->addTask("old");
+        oldTask->addTag("work");
+        oldTask->setStaged(false);
+        TaskRecord record = oldTask->toRecord();
+        record.modificationTimestamp = QDateTime::currentDateTimeUtc().addDays(-100).toMSecsSinceEpoch();
+        oldTask->fromRecord(record);
+        storage->save();
+        QTRY_VERIFY(!storage->savingInProgress());
+        QVERIFY(QFile::exists(storage->archiveFileName()));
+        QCOMPARE(storage->taskCount(), 2); // Still in memory in this session
+    }
+
+    // Switching backends keeps the archived tasks
+    {
+        RuntimeConfiguration sqliteConfig = config;
+        sqliteConfig.setStorageBackend(RuntimeConfiguration::StorageBackendSqlite);
+        QScopedPointer<Kernel> kernel(createSessionKernel(sqliteConfig));
+        SqliteStorage *storage = qobject_cast<SqliteStorage*>(kernel->storage());
+        QVERIFY(storage);
+        QCOMPARE(storage->taskCount(), 2);
+        QCOMPARE(storage->taskAt(1)->summary(), QString("old"));
+        QCOMPARE(storage->taskUuidsForTag("work").count(), 2);
+    }
+
+    {
+        QScopedPointer<Kernel> kernel(createSessionKernel(config));
+        JsonStorage *storage = qobject_cast<JsonStorage*>(kernel->storage());
+        QVERIFY(storage);
+        QVERIFY(!storage->archiveLoaded());
+        QCOMPARE(storage->taskCount(), 1);
+        QCOMPARE(storage->taskAt(0)->summary(), QString("recent"));
+        QCOMPARE(storage->tag("work", false)->taskCount(), 2); // The summary counts the archived one
+
+        // Tags renamed while the archive isn't loaded are followed
+        QVERIFY(storage->renameTag("work", "job"));
+        storage->loadArchive();
+        QVERIFY(storage->archiveLoaded());
+        QCOMPARE(storage->taskCount(), 1); // Loaded as a dormant record, no Task yet
+        QCOMPARE(storage->dormantTaskCount(), 1);
+        QCOMPARE(storage->tag("job", false)->taskCount(), 2);
+        QVERIFY(!storage->containsTag("work"));
+
+        storage->materializeTasksWithTag("job");
+        QCOMPARE(storage->taskCount(), 2);
+        QCOMPARE(storage->dormantTaskCount(), 0);
+        QCOMPARE(storage->tag("job", false)->taskCount(), 2);
+        Task::Ptr oldTask = storage->taskAt(1);
+        QCOMPARE(oldTask->summary(), QString("old"));
+        QVERIFY(oldTask->containsTag("job"));
+
+        // Untouched, so it can go back to being a record
+        QCOMPARE(storage->recycleMaterializedTasks(), 1);
+        QCOMPARE(storage->taskCount(), 1);
+        QCOMPARE(storage->tag("job", false)->taskCount(), 2);
+        oldTask = storage->materializeTask(oldTask->uuid());
+        QVERIFY(oldTask);
+        QCOMPARE(storage->taskCount(), 2);
+
+        // Brought back to the data file once it's touched
+        oldTask->setStaged(true);
+        QCOMPARE(storage->recycleMaterializedTasks(), 0);
+        storage->save();
+        QTRY_VERIFY(!storage->savingInProgress());
+        QVERIFY(!QFile::exists(storage->archiveFileName()));
+
+        // With the archive gone, saves go back to appending to the journal
+        oldTask->setSummary("not so old");
+        storage->save();
+        QTRY_VERIFY(!storage->savingInProgress());
+        QVERIFY(QFile::exists(storage->journalFileName()));
+    }
+
+    {
+        QScopedPointer<Kernel> kernel(createSessionKernel(config));
+        Storage *storage = kernel->storage();
+        QVERIFY(storage->archiveLoaded());
+        QCOMPARE(storage->taskCount(), 2);
+        QCOMPARE(storage->taskAt(1)->summary(), QString("not so old"));
+    }
+}
+
+void TestStorage::testParallelDeserializer()
+{
+    QByteArray json = "{ \"tags\": [ {\"name\": \"work\"} ], \"tasks\": [";
+    const int numTasks = 5000;
+    for (int i = 0; i < numTasks; ++i) {
+        json += "{\"summary\": \"task " + QByteArray::number(i) + "\", \"priority\": " + QByteArray::number(i % 3)
+                + ", \"tags\": [" + (i % 2 ? "\"work\"" : "") + "], \"uuid\": \"{u" + QByteArray::number(i) + "}\"}";
+        json += i == numTasks - 1 ? "]}" : ",";
+    }
+
+    QString errorMsg;
+    Storage::Data sequential = JsonStorage::deserializeJsonData(json, errorMsg, Q_NULLPTR, 1);
+    QVERIFY(errorMsg.isEmpty());
+    Storage::Data parallel = JsonStorage::deserializeJsonData(json, errorMsg, Q_NULLPTR, 4);
+    QVERIFY(errorMsg.isEmpty());
+    QCOMPARE(parallel.tasks.count(), numTasks);
+    QCOMPARE(sequential.tasks.count(), numTasks);
+    for (int i = 0; i < numTasks; ++i) { // Same order too
+        QCOMPARE(parallel.tasks.at(i)->uuid(), sequential.tasks.at(i)->uuid());
+        QCOMPARE(parallel.tasks.at(i)->summary(), sequential.tasks.at(i)->summary());
+        QCOMPARE(parallel.tasks.at(i)->priority(), sequential.tasks.at(i)->priority());
+        QCOMPARE(parallel.tasks.at(i)->tags().count(), i % 2);
+    }
+
+    // An error in a task parsed by a worker is still reported
+    json.replace("\"task 4000\"", "\"task 4000");
+    JsonStorage::deserializeJsonData(json, errorMsg, Q_NULLPTR, 4);
+    QVERIFY(!errorMsg.isEmpty());
+}
+
+void TestStorage::testTaskColumns()
+{
+    m_storage->clearTasks();
+    const TaskColumns &columns = m_storage->taskColumns();
+    QCOMPARE(columns.count(), 0);
+
+    Task::Ptr task1 = m_storage->addTask("task1");
+    Task::Ptr task2 = m_storage->addTask("task2");
+    Task::Ptr task0 = m_storage->prependTask("task0");
+    QCOMPARE(columns.count(), 3);
+    QCOMPARE(m_storage->indexOfTask(task0), 0);
+    QCOMPARE(columns.flags(0), quint8(0));
+
+    task1->setStaged(true);
+    task2->addTag("tagA");
+    task2->setDueDate(QDate(2015, 3, 1));
+    task2->setPriority(Task::PriorityHigh);
+    const int row1 = m_storage->indexOfTask(task1);
+    const int row2 = m_storage->indexOfTask(task2);
+    QCOMPARE(columns.flags(row1), quint8(TaskColumns::StagedFlag));
+    QCOMPARE(columns.flags(row2), quint8(TaskColumns::TaggedFlag | TaskColumns::DueDateFlag));
+    QCOMPARE(columns.dueDay(row2), qint32(QDate(2015, 3, 1).toJulianDay()));
+    QCOMPARE(columns.priority(row2), qint8(Task::PriorityHigh));
+
+    // The proxies filter with the columns
+    QCOMPARE(m_storage->stagedTasksModel()->rowCount(), 1);
+    QCOMPARE(m_storage->archivedTasksModel()->rowCount(), 2);
+    QCOMPARE(m_storage->untaggedTasksModel()->rowCount(), 1);
+    QCOMPARE(m_storage->dueDateTasksModel()->rowCount(), 1);
+
+    m_storage->removeTask(task0);
+    QCOMPARE(columns.count(), 2);
+    QCOMPARE(m_storage->indexOfTask(task0), -1);
+    QCOMPARE(m_storage->indexOfTask(task1), 0);
+    QCOMPARE(m_storage->indexOfTask(task2), 1);
+    QCOMPARE(columns.flags(m_storage->indexOfTask(task2)), quint8(TaskColumns::TaggedFlag | TaskColumns::DueDateFlag));
+    QCOMPARE(m_storage->untaggedTasksModel()->rowCount(), 0);
+
+    // Edits after rows moved land in the task's new row
+    task1->setStaged(false);
+    QCOMPARE(columns.flags(m_storage->indexOfTask(task1)), quint8(0));
+    QCOMPARE(m_storage->stagedTasksModel()->rowCount(), 0);
+
+    m_storage->clearTasks();
+    QCOMPARE(columns.count(), 0);
+}
+
+void TestStorage::testBaselineFormat()
+{
+    // A data file written by older versions is written back byte for byte
+    QFile file("data_files/baseline.dat");
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    const QByteArray serializedData = file.readAll();
+    QString errorMsg;
+    Storage::Data data = JsonStorage::deserializeJsonData(serializedData, errorMsg, m_kernel);
+    QVERIFY(errorMsg.isEmpty());
+    QCOMPARE(data.tasks.count(), 2);
+    QCOMPARE(JsonStorage::serializeToJsonData(data), serializedData);
+}
@@ -44,6 +44,22 @@ private Q_SLOTS:
 
     void testPreserveInstanceId();
     void testSaveCount();
+    void testJournal();
+    void testStreamingDeserializer();
+    void testBinaryRoundTrip();
+    void testAtomicSave();
+    void testSaveCoalescing();
+    void testSqliteStorage();
+    void testBulkLoad();
+    void testTaskIndex();
+    void testRowLevelFiltering();
+    void testReadOnlyViews();
+    void testDueDateIndex();
+    void testStatistics();
+    void testArchive();
+    void testParallelDeserializer();
+    void testTaskColumns();
+    void testBaselineFormat();
 
 private:
     SignalSpy m_storageSpy;
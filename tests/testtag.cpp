@@ -102,6 +102,57 @@ void TestTag::testTaskCount()
     QVERIFY(checkStorageConsistency());
 }
 
+void TestTag::testTaskModel()
+{
+    m_storage->clearTasks();
+    Tag::Ptr tagD = m_storage->createTag("tagD");
+    Tag::Ptr tagE = m_storage->createTag("tagE");
+    QAbstractItemModel *modelD = tagD->taskModel();
+    QAbstractItemModel *modelE = tagE->taskModel();
+
+    Task::Ptr task1 = m_storage->addTask("task1");
+    Task::Ptr task2 = m_storage->addTask("task2");
+    Task::Ptr task3 = m_storage->addTask("task3");
+    task1->addTag("tagD");
+    task2->addTag("tagD");
+    task2->addTag("tagE");
+    QCOMPARE(tagD->taggedTasks().count(), 2);
+    QCOMPARE(tagE->taggedTasks().count(), 1);
+    QCOMPARE(modelD->rowCount(), 2);
+    QCOMPARE(modelE->rowCount(), 1);
+
+    // Staged tasks aren't shown, but stay in the posting list
+    task1->setStaged(true);
+    QCOMPARE(modelD->rowCount(), 1);
+    QCOMPARE(tagD->taggedTasks().count(), 2);
+    task1->setStaged(false);
+    QCOMPARE(modelD->rowCount(), 2);
+
+    // Sorted by priority
+    task2->setPriority(Task::PriorityHigh);
+    QCOMPARE(modelD->data(modelD->index(0, 0), Storage::TaskPtrRole).value<Task::Ptr>(), task2);
+
+    task2->removeTag("tagD");
+    QCOMPARE(modelD->rowCount(), 1);
+    task3->addTag("tagE");
+    QCOMPARE(modelE->rowCount(), 2);
+
+    m_storage->removeTask(task3);
+    QCOMPARE(modelE->rowCount(), 1);
+    QCOMPARE(tagE->taggedTasks().count(), 1);
+
+    m_storage->removeTag("tagE");
+    QCOMPARE(task2->tags().count(), 0);
+
+    m_storage->clearTasks();
+    QCOMPARE(modelD->rowCount(), 0);
+    QVERIFY(tagD->taggedTasks().isEmpty());
+    m_storage->removeTag("tagD");
+    tagD.clear();
+    tagE.clear();
+    QVERIFY(checkStorageConsistency());
+}
+
 void TestTag::testJson()
 {
     Tag::Ptr tag1 = Tag::Ptr(new Tag(m_kernel, "tag1"));
@@ -34,6 +34,7 @@ private Q_SLOTS:
 
     void testSetName();
     void testTaskCount();
+    void testTaskModel();
     void testJson();
 
 private:
@@ -20,6 +20,9 @@
 #include "testtask.h"
 #include "storage.h"
 
+#include <QPointer>
+#include <QSignalSpy>
+
 TestTask::TestTask() : TestBase()
 {
 }
@@ -134,6 +137,27 @@ void TestTask::testJson()
     QCOMPARE(task->staged(), task2->staged());
     QCOMPARE(task->tags().count(), task2->tags().count());
     QCOMPARE(task->tags().at(0).tagName(), task2->tags().at(0).tagName());
+
+    // Nothing is lost by storing uuid and timestamps in binary form
+    task->setLastPomodoroDate(QDateTime::currentDateTimeUtc());
+    map = task->toJson();
+    task2->fromJson(map);
+    QCOMPARE(task2->toJson(), map);
+    QCOMPARE(task2->uuid(), task->uuid());
+    QCOMPARE(task2->creationDate(), task->creationDate());
+    QCOMPARE(task2->lastPomodoroDate(), task->lastPomodoroDate());
+    QVERIFY(*task2 == *task);
+
+    // Loaded tasks and dormant records serialize the same, also without timestamps
+    QVariantMap untimed;
+    untimed.insert("uuid", "{u1}");
+    untimed.insert("summary", "untimed");
+    task2->fromJson(untimed);
+    QCOMPARE(task2->toJson(), Task::recordToJson(Task::recordFromJson(untimed)));
+    QCOMPARE(task2->toJson().value("modificationTimestamp").toLongLong(), qint64(0)); // Like older versions did
+
+    // Only a task that never had one leaves the timestamp out
+    QVERIFY(!Task::createTask(m_kernel)->toJson().contains("lastPomodoroDate"));
 }
 
 void TestTask::testToggleTag()
@@ -155,3 +179,134 @@ void TestTask::testDueDate()
     task->removeDueDate();
     QCOMPARE(task->dueDateString(), QString());
 }
+
+void TestTask::testLazyMenuModels()
+{
+    Task::Ptr task = Task::createTask(m_kernel, "testLazyMenuModels");
+    QSignalSpy spy(task.data(), SIGNAL(menuModelsChanged()));
+    QVERIFY(!task->hasMenuModels());
+    QVERIFY(task->contextMenuModel());
+    QVERIFY(task->hasMenuModels());
+    QVERIFY(task->sortedContextMenuModel());
+    QVERIFY(task->checkableTagModel());
+    QCOMPARE(spy.count(), 1);
+
+    QPointer<QAbstractItemModel> checkableTagModel = task->checkableTagModel();
+    task->releaseMenuModels();
+    QVERIFY(!task->hasMenuModels());
+    QCOMPARE(spy.count(), 2);
+
+    // Recreated when the menu opens again, compared before the old one is gone
+    QAbstractItemModel *newCheckableTagModel = task->checkableTagModel();
+    QVERIFY(newCheckableTagModel);
+    QVERIFY(newCheckableTagModel != checkableTagModel.data());
+    QCOMPARE(spy.count(), 3);
+
+    QCoreApplication::sendPostedEvents(Q_NULLPTR, QEvent::DeferredDelete);
+    QVERIFY(!checkableTagModel);
+    QCOMPARE(task->checkableTagModel(), newCheckableTagModel);
+}
+
+static bool referenceLessThan(const Task::Ptr &left, const Task::Ptr &right)
+{
+    const int leftPriority = left->priority() == Task::PriorityNone ? 9 : left->priority();
+    const int rightPriority = right->priority() == Task::PriorityNone ? 9 : right->priority();
+    if (leftPriority != rightPriority)
+        return leftPriority < rightPriority;
+
+    return left->creationDate() > right->creationDate();
+}
+
+void TestTask::testSortKey()
+{
+    const Task::Priority priorities[] = { Task::PriorityNone, Task::PriorityHigh, Task::PriorityLow };
+    const qint64 timestamps[] = { -86400000LL, 0, 1420070400000LL, 1420070400001LL, 4102444800000LL };
+
+    QList<Task::Ptr> tasks;
+    foreach (Task::Priority priority, priorities) {
+        foreach (qint64 timestamp, timestamps) {
+            TaskRecord record;
+            record.summary = "task";
+            record.priority = priority;
+            record.creationTimestamp = timestamp;
+            Task::Ptr task = Task::createTask(Q_NULLPTR);
+            task->fromRecord(record);
+            tasks << task;
+        }
+    }
+
+    foreach (const Task::Ptr &left, tasks) {
+        foreach (const Task::Ptr &right, tasks)
+            QCOMPARE(left->sortKey() < right->sortKey(), referenceLessThan(left, right));
+    }
+
+    // Changing the priority updates the key
+    Task::Ptr task = tasks.first();
+    const quint64 key = task->sortKey();
+    task->setPriority(Task::PriorityHigh);
+    QVERIFY(task->sortKey() < key);
+}
+
+void TestTask::testTagRefCopies()
+{
+    Task::Ptr task = m_storage->addTask("copies");
+    task->addTag("tagA");
+    Tag::Ptr tag = m_storage->tag("tagA", false);
+    QVERIFY(tag);
+    const int count = tag->taskCount();
+    QSignalSpy spy(tag.data(), SIGNAL(taskCountChanged(int,int)));
+
+    // Copying tag refs around doesn't touch the count, only adding and removing tags does
+    QList<TagRef> copies = task->tags();
+    copies += copies;
+    TagRef ref = copies.first();
+    copies.clear();
+    QCOMPARE(spy.count(), 0);
+    QCOMPARE(tag->taskCount(), count);
+    QCOMPARE(ref.tagId(), tag->internId());
+    QVERIFY(ref.tag() == tag);
+
+    task->removeTag("tagA");
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(tag->taskCount(), count - 1);
+    m_storage->removeTask(task);
+}
+
+void TestTask::testUuidFormats()
+{
+    // Uuids QUuid would format differently are written back as they were read
+    QStringList uuids;
+    uuids << "{6a3f1c1e-1d2b-4c7a-9f3e-2b1c0d9e8f7a}" << "{6A3F1C1E-1D2B-4C7A-9F3E-2B1C0D9E8F7A}"
+          << "6a3f1c1e-1d2b-4c7a-9f3e-2b1c0d9e8f7a" << "{u0}";
+    foreach (const QString &uuid, uuids) {
+        QVariantMap map;
+        map.insert("uuid", uuid);
+        map.insert("summary", "task");
+        Task::Ptr task = Task::createTask(m_kernel);
+        task->fromJson(map);
+        QCOMPARE(task->uuid(), uuid);
+        QCOMPARE(task->toJson().value("uuid").toString(), uuid);
+
+        Task::Ptr sameTask = Task::createTask(m_kernel);
+        sameTask->fromJson(map);
+        QVERIFY(*task == *sameTask);
+    }
+
+    // Spelled differently isn't the same uuid, like before
+    Task::Ptr lowerCase = Task::createTask(m_kernel);
+    lowerCase->setUuid(uuids.at(0));
+    Task::Ptr upperCase = Task::createTask(m_kernel);
+    upperCase->setUuid(uuids.at(1));
+    QVERIFY(!(*lowerCase == *upperCase));
+    QVERIFY(!(*lowerCase == *Task::createTask(m_kernel)));
+
+    // Containers are keyed by the binary uuid, other spellings get their own key
+    Task::Ptr generated = Task::createTask(m_kernel);
+    QCOMPARE(generated->uuidKey(), QUuid(generated->uuid()));
+    QCOMPARE(Syncable::keyForUuid(generated->uuid()), generated->uuidKey());
+    QCOMPARE(Syncable::keyForUuid(uuids.at(0)), lowerCase->uuidKey());
+    QCOMPARE(Syncable::keyForUuid(uuids.at(1)), upperCase->uuidKey());
+    QVERIFY(lowerCase->uuidKey() != upperCase->uuidKey());
+    QVERIFY(Syncable::keyForUuid("{u0}") != Syncable::keyForUuid("{u1}"));
+    QVERIFY(!(*generated == *lowerCase));
+}
@@ -37,6 +37,10 @@ private Q_SLOTS:
     void testJson();
     void testToggleTag();
     void testDueDate();
+    void testLazyMenuModels();
+    void testSortKey();
+    void testTagRefCopies();
+    void testUuidFormats();
 private:
     Task::Ptr m_task1;
     Task::Ptr m_task2;
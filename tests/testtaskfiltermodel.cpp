@@ -68,3 +68,31 @@ void TestTaskFilterModel::testDueDateFiltering()
     QCOMPARE(task1, taskAt1);
     QCOMPARE(task2, taskAt0);
 }
+
+void TestTaskFilterModel::testTaskAt()
+{
+    Storage::Data emptyData;
+    m_storage->setData(emptyData);
+    Task::Ptr task1 = m_storage->addTask("task1");
+    Task::Ptr task2 = m_storage->addTask("task2");
+    task1->setDueDate(QDate::currentDate());
+    task2->setDueDate(QDate::currentDate().addDays(-1));
+    task1->addTag("tagA");
+
+    // Sources are the task list, another proxy and a tag's task list
+    QList<TaskFilterProxyModel*> models;
+    models << m_storage->archivedTasksModel() << m_storage->dueDateTasksModel()
+           << static_cast<TaskFilterProxyModel*>(m_storage->tag("tagA")->taskModel());
+    foreach (TaskFilterProxyModel *model, models) {
+        QVERIFY(model->rowCount() > 0);
+        for (int i = 0; i < model->rowCount(); ++i) {
+            Task::Ptr task = model->data(model->index(i, 0), Storage::TaskPtrRole).value<Task::Ptr>();
+            QCOMPARE(model->taskAt(i), task.data());
+        }
+    }
+
+    QCOMPARE(m_storage->dueDateTasksModel()->taskAt(0), task2.data());
+    QVERIFY(!m_storage->dueDateTasksModel()->taskAt(2));
+    m_storage->setData(emptyData);
+    m_storage->removeTag("tagA");
+}
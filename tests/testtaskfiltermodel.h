@@ -33,6 +33,7 @@ private Q_SLOTS:
     void initTestCase();
     void cleanupTestCase();
     void testDueDateFiltering();
+    void testTaskAt();
 };
 
 #endif